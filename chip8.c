@@ -28,6 +28,28 @@ static uint8_t chip8_fontset[] = {
 	0xF0, 0x80, 0xF0, 0x80, 0x80  	/* F */
 };
 
+/*
+ * SUPER-CHIP / XO-CHIP big fontset (8x10).
+ */
+static uint8_t chip8_bigfontset[] = {
+	0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,	/* 0 */
+	0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,	/* 1 */
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,	/* 2 */
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,	/* 3 */
+	0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,	/* 4 */
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,	/* 5 */
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,	/* 6 */
+	0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,	/* 7 */
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,	/* 8 */
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,	/* 9 */
+	0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,	/* A */
+	0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,	/* B */
+	0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,	/* C */
+	0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,	/* D */
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,	/* E */
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0	/* F */
+};
+
 /*
  * Chip8 key map.
  */
@@ -36,24 +58,365 @@ uint8_t chip8_keymap[] = {
 };
 
 /*
- * Init chip8.
+ * Load fontsets in memory.
+ */
+static void chip8_load_fonts(struct chip8_t *chip8)
+{
+	memcpy(chip8->memory, chip8_fontset, sizeof(chip8_fontset));
+	memcpy(chip8->memory + CHIP8_BIGFONT_ADDR, chip8_bigfontset, sizeof(chip8_bigfontset));
+}
+
+/*
+ * Gray levels of plane combinations.
+ */
+uint8_t chip8_palette[1 << CHIP8_GFX_NR_PLANES] = {
+	0x00, 0xFF, 0xAA, 0x55
+};
+
+/* execution context must stay in one cache line */
+_Static_assert(offsetof(struct chip8_t, stack) == CHIP8_CACHE_LINE, "chip8 execution context layout");
+
+/*
+ * Init an arena (memory regions of machines created from it are carved out of buf).
+ */
+void chip8_arena_init(struct chip8_arena_t *arena, void *buf, size_t size)
+{
+	arena->base = (uint8_t *) buf;
+	arena->size = size;
+	arena->used = 0;
+}
+
+/*
+ * Allocate a cache line aligned memory region from an arena.
+ */
+static uint8_t *chip8_arena_alloc(struct chip8_arena_t *arena, size_t size)
+{
+	size_t start = arena->used + (-(uintptr_t) (arena->base + arena->used) & (CHIP8_CACHE_LINE - 1));
+
+	if (start + size > arena->size)
+		return NULL;
+
+	arena->used = start + size;
+	return arena->base + start;
+}
+
+/*
+ * Create a chip8 for a quirks profile : context, memory, display and keypad regions are
+ * allocated separately, memory (sized for the profile) from arena if not NULL.
+ * The chip8 is initialized.
+ */
+struct chip8_t *chip8_create(struct chip8_arena_t *arena, uint8_t quirks)
+{
+	struct chip8_t *chip8;
+
+	/* execution context */
+	chip8 = (struct chip8_t *) aligned_alloc(CHIP8_CACHE_LINE, sizeof(struct chip8_t));
+	if (!chip8)
+		return NULL;
+	memset(chip8, 0, sizeof(struct chip8_t));
+
+	/* memory region */
+	chip8->mem_size = CHIP8_MEMORY_SIZE(quirks);
+	chip8->mem_mask = chip8->mem_size - 1;
+	chip8->quirks = quirks;
+	if (arena) {
+		chip8->memory = chip8_arena_alloc(arena, chip8->mem_size);
+		chip8->arena_memory = 1;
+	} else {
+		chip8->memory = (uint8_t *) aligned_alloc(CHIP8_CACHE_LINE, chip8->mem_size);
+	}
+
+	/* display and keypad regions */
+	chip8->gfx = aligned_alloc(CHIP8_CACHE_LINE, CHIP8_GFX_SIZE);
+	chip8->key = (uint8_t *) aligned_alloc(CHIP8_CACHE_LINE, CHIP8_CACHE_LINE);
+
+	if (!chip8->memory || !chip8->gfx || !chip8->key) {
+		chip8_destroy(chip8);
+		return NULL;
+	}
+
+	chip8_init(chip8);
+	return chip8;
+}
+
+/*
+ * Destroy a chip8 (arena memory is left to the arena owner).
+ */
+void chip8_destroy(struct chip8_t *chip8)
+{
+	if (!chip8)
+		return;
+
+	if (!chip8->arena_memory)
+		free(chip8->memory);
+	free(chip8->gfx);
+	free(chip8->key);
+	free(chip8);
+}
+
+/*
+ * Init chip8 (regions and quirks are kept, regions are cleared).
  */
 void chip8_init(struct chip8_t *chip8)
 {
-	int i;
+	uint64_t (*gfx)[CHIP8_GFX_HIRES_HEIGHT][CHIP8_GFX_ROW_WORDS] = chip8->gfx;
+	uint8_t *memory = chip8->memory, *key = chip8->key;
+	char arena_memory = chip8->arena_memory;
+	uint32_t mem_size = chip8->mem_size;
+	uint16_t mem_mask = chip8->mem_mask;
+	uint8_t quirks = chip8->quirks;
 
 	/* clear chip8 */
 	memset(chip8, 0, sizeof(struct chip8_t));
+	chip8->memory = memory;
+	chip8->gfx = gfx;
+	chip8->key = key;
+	chip8->arena_memory = arena_memory;
+	chip8->mem_size = mem_size;
+	chip8->mem_mask = mem_mask;
+	chip8->quirks = quirks;
+	memset(chip8->memory, 0, chip8->mem_size);
+	memset(chip8->gfx, 0, CHIP8_GFX_SIZE);
+	memset(chip8->key, 0, CHIP8_NR_KEYS);
 
 	/* set program counter to 0x200 */
 	chip8->pc = CHIP8_MEMORY_ROM_START;
 
-	/* load fontset in memory */
-	for (i = 0; i < CHIP8_NR_KEYS * CHIP8_FONT_SIZE; i++)
-		chip8->memory[i] = chip8_fontset[i];
+	/* low resolution, draw on first plane */
+	chip8->planes = 1;
+
+	/* default audio pitch (4000 Hz pattern playback) */
+	chip8->pitch = CHIP8_AUDIO_DEFAULT_PITCH;
+
+	/* default timing */
+	chip8->timing = CHIP8_TIMING_FIXED;
+
+	/* load fontsets in memory */
+	chip8_load_fonts(chip8);
 
 	/* seed */
-	srand(time(NULL));
+	chip8_seed(chip8, time(NULL));
+}
+
+/*
+ * Mark memory holding a ROM of size bytes dirty.
+ */
+static void chip8_rom_dirty(struct chip8_t *chip8, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i += CHIP8_MEMORY_BLOCK_SIZE)
+		CHIP8_MEM_DIRTY(chip8, CHIP8_MEMORY_ROM_START + i);
+	if (size)
+		CHIP8_MEM_DIRTY(chip8, CHIP8_MEMORY_ROM_START + size - 1);
+}
+
+/*
+ * Restore a memory block to its initial content.
+ */
+static void chip8_restore_block(struct chip8_t *chip8, int blk)
+{
+	memset(chip8->memory + blk * CHIP8_MEMORY_BLOCK_SIZE, 0, CHIP8_MEMORY_BLOCK_SIZE);
+	if (blk * CHIP8_MEMORY_BLOCK_SIZE < CHIP8_FONTS_END)
+		chip8_load_fonts(chip8);
+}
+
+/*
+ * Reset chip8 to its initial state, restoring only what changed since the last init/reset.
+ */
+void chip8_reset(struct chip8_t *chip8)
+{
+	int i, blk;
+
+	/* restore dirty memory blocks */
+	for (i = 0; i < (CHIP8_MEMORY_NR_BLOCKS + 63) / 64; i++) {
+		while (chip8->mem_dirty[i]) {
+			blk = i * 64 + __builtin_ctzll(chip8->mem_dirty[i]);
+			chip8->mem_dirty[i] &= chip8->mem_dirty[i] - 1;
+			chip8_restore_block(chip8, blk);
+		}
+	}
+
+	/* clear graphics buffer */
+	if (chip8->gfx_dirty) {
+		memset(chip8->gfx, 0, CHIP8_GFX_SIZE);
+		chip8->gfx_dirty = 0;
+	}
+	chip8->hires = 0;
+	chip8->planes = 1;
+
+	/* reset registers */
+	memset(chip8->stack, 0, sizeof(chip8->stack));
+	memset(chip8->V, 0, sizeof(chip8->V));
+	memset(chip8->key, 0, CHIP8_NR_KEYS);
+	memset(chip8->rpl, 0, sizeof(chip8->rpl));
+	chip8->sp = 0;
+	chip8->pc = CHIP8_MEMORY_ROM_START;
+	chip8->I = 0;
+	chip8->delay_timer = 0;
+	chip8->sound_timer = 0;
+	chip8->timer_us = 0;
+	chip8->display_wait = 0;
+	chip8->cycle_budget = 0;
+	chip8->cycles = 0;
+	chip8->frames = 0;
+	memset(chip8->pattern, 0, sizeof(chip8->pattern));
+	chip8->pitch = CHIP8_AUDIO_DEFAULT_PITCH;
+	chip8->pattern_flag = 0;
+	chip8->draw_flag = 0;
+}
+
+/*
+ * Seed random generator.
+ */
+void chip8_seed(struct chip8_t *chip8, uint32_t seed)
+{
+	/* xorshift state must not be 0 */
+	chip8->rng = seed ? seed : 1;
+}
+
+/*
+ * Set quirks (kept across resets). Fails if the profile needs more memory than the chip8 was created with.
+ */
+int chip8_set_quirks(struct chip8_t *chip8, uint8_t quirks)
+{
+	if (CHIP8_MEMORY_SIZE(quirks) > chip8->mem_size)
+		return EXIT_FAILURE;
+
+	chip8->quirks = quirks;
+	chip8->mem_mask = CHIP8_MEMORY_SIZE(quirks) - 1;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Set timing mode (kept across resets).
+ */
+void chip8_set_timing(struct chip8_t *chip8, uint8_t timing)
+{
+	chip8->timing = timing;
+	chip8->cycle_budget = 0;
+}
+
+/*
+ * Get timing mode by name ("fixed" or "vip"), -1 if unknown.
+ */
+int chip8_timing(const char *name)
+{
+	if (strcmp(name, "fixed") == 0)
+		return CHIP8_TIMING_FIXED;
+	if (strcmp(name, "vip") == 0)
+		return CHIP8_TIMING_VIP;
+
+	return -1;
+}
+
+/*
+ * Get quirks of a profile by name ("cosmac", "schip" or "xochip"), -1 if unknown.
+ */
+int chip8_profile(const char *name)
+{
+	if (strcmp(name, "cosmac") == 0)
+		return CHIP8_PROFILE_COSMAC;
+	if (strcmp(name, "schip") == 0)
+		return CHIP8_PROFILE_SCHIP;
+	if (strcmp(name, "xochip") == 0)
+		return CHIP8_PROFILE_XOCHIP;
+
+	return -1;
+}
+
+/*
+ * Init a snapshot of chip8 (its memory is allocated for chip8 memory size).
+ */
+int chip8_state_init(struct chip8_state_t *state, const struct chip8_t *chip8)
+{
+	memset(state, 0, sizeof(struct chip8_state_t));
+
+	state->memory = (uint8_t *) aligned_alloc(CHIP8_CACHE_LINE, chip8->mem_size);
+	if (!state->memory)
+		return EXIT_FAILURE;
+	state->mem_size = chip8->mem_size;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Free a snapshot.
+ */
+void chip8_state_free(struct chip8_state_t *state)
+{
+	free(state->memory);
+	state->memory = NULL;
+	state->mem_size = 0;
+}
+
+/*
+ * Save chip8 state into a snapshot (of the same memory size).
+ * Memory blocks never written since last init/reset are not copied.
+ */
+void chip8_save_state(const struct chip8_t *chip8, struct chip8_state_t *state)
+{
+	int i;
+
+	/* context, display and keypad */
+	memcpy(&state->ctx, chip8, sizeof(struct chip8_t));
+	memcpy(state->gfx, chip8->gfx, CHIP8_GFX_SIZE);
+	memcpy(state->key, chip8->key, CHIP8_NR_KEYS);
+
+	/* dirty memory blocks */
+	for (i = 0; i < (int) (state->mem_size / CHIP8_MEMORY_BLOCK_SIZE); i++)
+		if (chip8->mem_dirty[i / 64] & (1ULL << (i % 64)))
+			memcpy(state->memory + i * CHIP8_MEMORY_BLOCK_SIZE, chip8->memory + i * CHIP8_MEMORY_BLOCK_SIZE, CHIP8_MEMORY_BLOCK_SIZE);
+}
+
+/*
+ * Restore chip8 state from a snapshot of the same memory size (regions are kept, their content is restored).
+ * Only memory blocks written since last init/reset, here or in the snapshot, are restored.
+ */
+void chip8_load_state(struct chip8_t *chip8, const struct chip8_state_t *state)
+{
+	uint64_t (*gfx)[CHIP8_GFX_HIRES_HEIGHT][CHIP8_GFX_ROW_WORDS] = chip8->gfx;
+	uint8_t *memory = chip8->memory, *key = chip8->key;
+	char arena_memory = chip8->arena_memory;
+	uint32_t mem_size = chip8->mem_size;
+	int i;
+
+	/* memory blocks dirty in snapshot : copy them, dirty now only : restore their initial content */
+	for (i = 0; i < (int) (state->mem_size / CHIP8_MEMORY_BLOCK_SIZE); i++) {
+		if (state->ctx.mem_dirty[i / 64] & (1ULL << (i % 64)))
+			memcpy(chip8->memory + i * CHIP8_MEMORY_BLOCK_SIZE, state->memory + i * CHIP8_MEMORY_BLOCK_SIZE, CHIP8_MEMORY_BLOCK_SIZE);
+		else if (chip8->mem_dirty[i / 64] & (1ULL << (i % 64)))
+			chip8_restore_block(chip8, i);
+	}
+
+	/* context (keeping regions), display and keypad */
+	memcpy(chip8, &state->ctx, sizeof(struct chip8_t));
+	chip8->memory = memory;
+	chip8->gfx = gfx;
+	chip8->key = key;
+	chip8->arena_memory = arena_memory;
+	chip8->mem_size = mem_size;
+	memcpy(chip8->gfx, state->gfx, CHIP8_GFX_SIZE);
+	memcpy(chip8->key, state->key, CHIP8_NR_KEYS);
+}
+
+/*
+ * Load a ROM from a buffer (chip8 is not reset).
+ */
+int chip8_load_rom_buffer(struct chip8_t *chip8, const uint8_t *buf, size_t size)
+{
+	/* check rom size */
+	if (size > chip8->mem_mask + 1U - CHIP8_MEMORY_ROM_START)
+		return EXIT_FAILURE;
+
+	/* load rom into memory */
+	memcpy(chip8->memory + CHIP8_MEMORY_ROM_START, buf, size);
+
+	/* mark rom memory dirty */
+	chip8_rom_dirty(chip8, size);
+
+	return EXIT_SUCCESS;
 }
 
 /*
@@ -79,13 +442,16 @@ int chip8_load_rom(struct chip8_t *chip8, const char *path)
 	fseek(rom_fp, 0, SEEK_SET);
 
 	/* check rom size */
-	if (rom_size > CHIP8_MEMORY_SIZE - CHIP8_MEMORY_ROM_START)
+	if (rom_size > chip8->mem_mask + 1U - CHIP8_MEMORY_ROM_START)
 		goto out;
 
 	/* load rom into memory */
 	if (fread(chip8->memory + CHIP8_MEMORY_ROM_START, sizeof(char), rom_size, rom_fp) != rom_size)
 		goto out;
 
+	/* mark rom memory dirty */
+	chip8_rom_dirty(chip8, rom_size);
+
 	ret = EXIT_SUCCESS;
 out:
 	if (rom_fp)
@@ -94,6 +460,24 @@ out:
 	return ret;
 }
 
+/*
+ * End of a 60 Hz frame : update timers.
+ */
+static void chip8_end_frame(struct chip8_t *chip8)
+{
+	/* update delay timer */
+	if (chip8->delay_timer > 0)
+		chip8->delay_timer--;
+
+	/* update sound timer */
+	if (chip8->sound_timer > 0)
+		chip8->sound_timer--;
+
+	/* display wait is over */
+	chip8->display_wait = 0;
+	chip8->frames++;
+}
+
 /*
  * Handle next tick.
  */
@@ -101,8 +485,18 @@ int chip8_tick(struct chip8_t *chip8)
 {
 	uint16_t opcode;
 
+	/* display wait : idle until next frame */
+	if (chip8->display_wait)
+		goto timers;
+
 	/* fetch next opcode */
-	opcode = (chip8->memory[chip8->pc] << 8) | chip8->memory[chip8->pc + 1];
+	opcode = (chip8->memory[CHIP8_ADDR(chip8, chip8->pc)] << 8) | chip8->memory[CHIP8_ADDR(chip8, chip8->pc + 1)];
+
+	/* count cycles (VIP cost depends on state before execution) */
+	if (chip8->timing == CHIP8_TIMING_VIP)
+		chip8->cycles += chip8_vip_cycles(chip8, opcode);
+	else
+		chip8->cycles++;
 
 	/* process opcode */
 	switch (opcode & 0xF000) {
@@ -112,10 +506,32 @@ int chip8_tick(struct chip8_t *chip8)
 					chip8_clear_screen(chip8);
 					break;
 				case 0x00EE:								/* 00EE -> return from a subroutine */
+					if (chip8->sp == 0)
+						goto err_stack;
 					chip8_return_subroutine(chip8);
 					break;
+				case 0x00FB:								/* 00FB -> scroll right 4 pixels */
+					chip8_scroll_right(chip8);
+					break;
+				case 0x00FC:								/* 00FC -> scroll left 4 pixels */
+					chip8_scroll_left(chip8);
+					break;
+				case 0x00FD:								/* 00FD -> exit interpreter */
+					chip8_exit(chip8);
+					break;
+				case 0x00FE:								/* 00FE -> low resolution (64x32) */
+					chip8_set_hires(chip8, 0);
+					break;
+				case 0x00FF:								/* 00FF -> high resolution (128x64) */
+					chip8_set_hires(chip8, 1);
+					break;
 				default:
-					goto err_opcode;
+					if ((opcode & 0x00F0) == 0x00C0)					/* 00CN -> scroll down N lines */
+						chip8_scroll_down(chip8, opcode & 0x000F);
+					else if ((opcode & 0x00F0) == 0x00D0)				/* 00DN -> scroll up N lines */
+						chip8_scroll_up(chip8, opcode & 0x000F);
+					else
+						goto err_opcode;
 			}
 
 			break;
@@ -123,6 +539,8 @@ int chip8_tick(struct chip8_t *chip8)
 			chip8_jump(chip8, opcode & 0x0FFF);
 			break;
 		case 0x2000:										/* 2NNN -> call subroutine at NNN */
+			if (chip8->sp >= CHIP8_STACK_SIZE)
+				goto err_stack;
 			chip8_call_subroutine(chip8, opcode & 0x0FFF);
 			break;
 		case 0x3000:										/* 3XNN -> skip next instruction if V[X] == NN */
@@ -131,8 +549,21 @@ int chip8_tick(struct chip8_t *chip8)
 		case 0x4000:										/* 3XNN -> skip next instruction if V[X] != NN */
 			chip8_skip_if_reg_different_val(chip8, (opcode & 0x0F00) >> 8, opcode & 0x00FF);
 			break;
-		case 0x5000:										/* 5XY0 -> skip next instruction if V[X] == V[Y] */
-			chip8_skip_if_reg_equal_reg(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
+		case 0x5000:
+			switch (opcode & 0x000F) {
+				case 0x0000:								/* 5XY0 -> skip next instruction if V[X] == V[Y] */
+					chip8_skip_if_reg_equal_reg(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
+					break;
+				case 0x0002:								/* 5XY2 -> save V[X] .. V[Y] at I */
+					chip8_reg_save_range(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
+					break;
+				case 0x0003:								/* 5XY3 -> load V[X] .. V[Y] from I */
+					chip8_reg_load_range(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
+					break;
+				default:
+					goto err_opcode;
+			}
+
 			break;
 		case 0x6000:										/* 6XNN -> V[X] = NN */
 			chip8_set_reg_val(chip8, (opcode & 0x0F00) >> 8, opcode & 0x00FF);
@@ -160,14 +591,14 @@ int chip8_tick(struct chip8_t *chip8)
 				case 0x0005:								/* 8XY5 -> V[X] -= V[Y] */
 					chip8_sub_reg_reg(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
 					break;
-				case 0x0006:								/* 8XY6 -> V[X] >>= 1 */
-					chip8_rshift_reg(chip8, (opcode & 0x0F00) >> 8);
+				case 0x0006:								/* 8XY6 -> V[X] = V[Y] >> 1 */
+					chip8_rshift_reg(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
 					break;
 				case 0x0007:								/* 8XY7 -> V[X] = V[Y] - V[X] */
 					chip8_sub_reg_reg_inv(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
 					break;
-				case 0x000E:								/* 8XYE -> V[X] <<= 1 */
-					chip8_lshift_reg(chip8, (opcode & 0x0F00) >> 8);
+				case 0x000E:								/* 8XYE -> V[X] = V[Y] << 1 */
+					chip8_lshift_reg(chip8, (opcode & 0x0F00) >> 8, (opcode & 0x00F0) >> 4);
 					break;
 				default:
 					goto err_opcode;
@@ -180,13 +611,13 @@ int chip8_tick(struct chip8_t *chip8)
 		case 0xA000:										/* ANNN -> I = NNN */
 			chip8_set_I(chip8, opcode & 0x0FFF);
 			break;
-		case 0xB000:										/* BNNN -> jump to the address NNN + V[0] */
+		case 0xB000:										/* BNNN -> jump to NNN + V[0] (XNN + V[X] with jump quirk) */
 			chip8_jump_plus_v0(chip8, opcode & 0x0FFF);
 			break;
 		case 0xC000:										/* CXNN -> V[X] = rand() & NN */
 			chip8_rand(chip8, (opcode & 0x0F00) >> 8, opcode & 0x00FF);
 			break;
-		case 0xD000:										/* DXYN -> draw at (Vx ; Vy) of height N */
+		case 0xD000:										/* DXYN -> draw at (Vx ; Vy) of height N (16x16 if N = 0) */
 			chip8_draw(chip8, chip8->V[(opcode & 0x0F00) >> 8], chip8->V[(opcode & 0x00F0) >> 4], opcode & 0x000F);
 			break;
 		case 0xE000:
@@ -203,7 +634,18 @@ int chip8_tick(struct chip8_t *chip8)
 
 			break;
 		case 0xF000:
+			if (opcode == 0xF000) {								/* F000 NNNN -> I = NNNN */
+				chip8_set_I_long(chip8);
+				break;
+			}
+
 			switch (opcode & 0x00FF) {
+				case 0x0001:								/* FN01 -> select planes N */
+					chip8_select_planes(chip8, (opcode & 0x0F00) >> 8);
+					break;
+				case 0x0002:								/* F002 -> load audio pattern from I */
+					chip8_load_pattern(chip8);
+					break;
 				case 0x0007:								/* FX07 -> V[X] = get_delay() : blocking instruction */
 				 	chip8_get_delay(chip8, (opcode & 0x0F00) >> 8);
 					break;
@@ -222,15 +664,27 @@ int chip8_tick(struct chip8_t *chip8)
 				case 0x0029:								/* FX29 -> I = sprite_addr(X) */
 					chip8_sprite_addr(chip8, (opcode & 0x0F00) >> 8);
 					break;
+				case 0x0030:								/* FX30 -> I = bigsprite_addr(X) */
+					chip8_bigsprite_addr(chip8, (opcode & 0x0F00) >> 8);
+					break;
 				case 0x0033:								/* FX33 -> store Binary Coded Decimal at I, I+1 and I+2*/
 				 	chip8_bcd(chip8, (opcode & 0x0F00) >> 8);
 					break;
+				case 0x003A:								/* FX3A -> set_pitch(V[X]) */
+					chip8_set_pitch(chip8, (opcode & 0x0F00) >> 8);
+					break;
 				case 0x0055:								/* FX55 -> reg_dump(V[X], &I) */
 					chip8_reg_dump(chip8, (opcode & 0x0F00) >> 8);
 					break;
 				case 0x0065:								/* FX65 -> reg_load(V[X], &I) */
 					chip8_reg_load(chip8, (opcode & 0x0F00) >> 8);
 					break;
+				case 0x0075:								/* FX75 -> rpl_save(V[X]) */
+					chip8_rpl_save(chip8, (opcode & 0x0F00) >> 8);
+					break;
+				case 0x0085:								/* FX85 -> rpl_load(V[X]) */
+					chip8_rpl_load(chip8, (opcode & 0x0F00) >> 8);
+					break;
 				default:
 					goto err_opcode;
 			}
@@ -240,16 +694,68 @@ int chip8_tick(struct chip8_t *chip8)
 			goto err_opcode;
 	}
 
-	/* update delay timer */
-	if (chip8->delay_timer > 0)
-		chip8->delay_timer--;
+timers:
+	/* VIP timing : frames are ended by chip8_run_frame() */
+	if (chip8->timing == CHIP8_TIMING_VIP)
+		return EXIT_SUCCESS;
 
-	/* update sound timer */
-	if (chip8->sound_timer > 0)
-		chip8->sound_timer--;
+	/* timers count down at 60 Hz of emulated time */
+	chip8->timer_us += CHIP8_TICK_FREQ_US;
+	if (chip8->timer_us >= CHIP8_FRAME_FREQ_US) {
+		chip8->timer_us -= CHIP8_FRAME_FREQ_US;
+		chip8_end_frame(chip8);
+	}
 
 	return EXIT_SUCCESS;
 err_opcode:
 	fprintf(stderr, "Unknown opcode %x\n", opcode);
 	return EXIT_FAILURE;
+err_stack:
+	fprintf(stderr, "Stack %s at %x\n", chip8->sp ? "overflow" : "underflow", chip8->pc);
+	return EXIT_FAILURE;
+}
+
+/*
+ * Emulate one 60 Hz frame.
+ * Fixed timing runs ticks until timers update. VIP timing runs instructions for a cycle
+ * budget (an overrun is taken from the next frame) : a draw with display wait ends the frame.
+ */
+int chip8_run_frame(struct chip8_t *chip8)
+{
+	uint32_t frames = chip8->frames;
+	uint64_t cycles;
+
+	if (chip8->timing == CHIP8_TIMING_FIXED) {
+		while (chip8->frames == frames)
+			if (chip8_tick(chip8))
+				return EXIT_FAILURE;
+
+		return EXIT_SUCCESS;
+	}
+
+	chip8->cycle_budget += CHIP8_VIP_FRAME_BUDGET;
+	while (chip8->cycle_budget > 0 && !chip8->display_wait) {
+		cycles = chip8->cycles;
+		if (chip8_tick(chip8))
+			return EXIT_FAILURE;
+		chip8->cycle_budget -= chip8->cycles - cycles;
+	}
+
+	/* rest of frame is spent waiting for display */
+	if (chip8->display_wait && chip8->cycle_budget > 0)
+		chip8->cycle_budget = 0;
+
+	chip8_end_frame(chip8);
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Get emulated cycles per second of emulated time (0 before the first frame).
+ */
+double chip8_cycles_per_second(const struct chip8_t *chip8)
+{
+	if (!chip8->frames)
+		return 0;
+
+	return (double) chip8->cycles * 1000000 / ((double) chip8->frames * CHIP8_FRAME_FREQ_US);
 }
@@ -2,42 +2,199 @@
 #define _CHIP8_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
-#define CHIP8_MEMORY_SIZE		4096
+#define CHIP8_MEMORY_MAX_SIZE		65536		/* XO-CHIP */
+#define CHIP8_MEMORY_4K_SIZE		4096		/* COSMAC VIP, SUPER-CHIP */
 #define CHIP8_MEMORY_ROM_START		0X200
-#define CHIP8_GFX_WIDTH			64
-#define CHIP8_GFX_HEIGHT		32
+#define CHIP8_GFX_LORES_WIDTH		64
+#define CHIP8_GFX_LORES_HEIGHT		32
+#define CHIP8_GFX_HIRES_WIDTH		128
+#define CHIP8_GFX_HIRES_HEIGHT		64
+#define CHIP8_GFX_NR_PLANES		2
 #define CHIP8_STACK_SIZE		16
 #define CHIP8_NR_REGISTERS		16
+#define CHIP8_NR_RPL			16
 #define CHIP8_NR_KEYS			16
 #define CHIP8_FONT_SIZE			5
+#define CHIP8_BIGFONT_ADDR		0x50
+#define CHIP8_BIGFONT_SIZE		10
 #define CHIP8_TICK_FREQ_US		1800
+#define CHIP8_FRAME_FREQ_US		16667
+#define CHIP8_AUDIO_PATTERN_SIZE	16
+#define CHIP8_AUDIO_DEFAULT_PITCH	64
 
-#define CHIP8_GFX_SIZE			(CHIP8_GFX_WIDTH * CHIP8_GFX_HEIGHT)
+#define CHIP8_FONTS_END			(CHIP8_BIGFONT_ADDR + CHIP8_NR_KEYS * CHIP8_BIGFONT_SIZE)
+#define CHIP8_GFX_ROW_WORDS		(CHIP8_GFX_HIRES_WIDTH / 64)
+#define CHIP8_MEMORY_BLOCK_SIZE		256
+#define CHIP8_MEMORY_NR_BLOCKS		(CHIP8_MEMORY_MAX_SIZE / CHIP8_MEMORY_BLOCK_SIZE)
+#define CHIP8_GFX_PLANE_SIZE		(CHIP8_GFX_HIRES_HEIGHT * CHIP8_GFX_ROW_WORDS * sizeof(uint64_t))
+#define CHIP8_GFX_SIZE			(CHIP8_GFX_NR_PLANES * CHIP8_GFX_PLANE_SIZE)
+#define CHIP8_CACHE_LINE		64
+
+/* quirks */
+#define CHIP8_QUIRK_VF_RESET		0x01		/* 8XY1, 8XY2, 8XY3 reset Vf */
+#define CHIP8_QUIRK_SHIFT		0x02		/* 8XY6, 8XYE shift Vx in place (Vy ignored) */
+#define CHIP8_QUIRK_LOAD_STORE		0x04		/* FX55, FX65 leave I unchanged */
+#define CHIP8_QUIRK_JUMP		0x08		/* BXNN jumps to XNN + Vx */
+#define CHIP8_QUIRK_CLIP		0x10		/* sprites are clipped at display edges instead of wrapping */
+#define CHIP8_QUIRK_DISPLAY_WAIT	0x20		/* DXYN waits for the next 60 Hz frame */
+#define CHIP8_QUIRK_MEMORY_4K		0x40		/* 4 KB memory (64 KB otherwise) */
+
+/* quirk profiles */
+#define CHIP8_PROFILE_COSMAC		(CHIP8_QUIRK_VF_RESET | CHIP8_QUIRK_CLIP | CHIP8_QUIRK_DISPLAY_WAIT | CHIP8_QUIRK_MEMORY_4K)
+#define CHIP8_PROFILE_SCHIP		(CHIP8_QUIRK_SHIFT | CHIP8_QUIRK_LOAD_STORE | CHIP8_QUIRK_JUMP | CHIP8_QUIRK_CLIP | CHIP8_QUIRK_MEMORY_4K)
+#define CHIP8_PROFILE_XOCHIP		0
+#define CHIP8_PROFILE_DEFAULT		CHIP8_PROFILE_XOCHIP
+
+/* timing modes */
+#define CHIP8_TIMING_FIXED		0		/* every instruction takes CHIP8_TICK_FREQ_US */
+#define CHIP8_TIMING_VIP		1		/* COSMAC VIP machine cycles, CHIP8_VIP_FRAME_BUDGET per frame */
+
+/* COSMAC VIP timing (1.76 MHz clock, 8 clocks per machine cycle) */
+#define CHIP8_VIP_CYCLES_PER_FRAME	3668		/* machine cycles per 60 Hz frame */
+#define CHIP8_VIP_DISPLAY_CYCLES	1070		/* display DMA (128 lines x 8 bytes) and interrupt routine */
+#define CHIP8_VIP_FRAME_BUDGET		(CHIP8_VIP_CYCLES_PER_FRAME - CHIP8_VIP_DISPLAY_CYCLES)
+
+/* memory size of a quirks profile */
+#define CHIP8_MEMORY_SIZE(quirks)	((quirks) & CHIP8_QUIRK_MEMORY_4K ? CHIP8_MEMORY_4K_SIZE : CHIP8_MEMORY_MAX_SIZE)
+
+/* wrap an address into memory */
+#define CHIP8_ADDR(chip8, addr)		((addr) & (chip8)->mem_mask)
+
+/* current display size */
+#define CHIP8_GFX_WIDTH(chip8)		((chip8)->hires ? CHIP8_GFX_HIRES_WIDTH : CHIP8_GFX_LORES_WIDTH)
+#define CHIP8_GFX_HEIGHT(chip8)		((chip8)->hires ? CHIP8_GFX_HIRES_HEIGHT : CHIP8_GFX_LORES_HEIGHT)
+
+/* get a pixel of a plane (rows are packed, most significant bit first) */
+#define CHIP8_GFX_PIXEL(chip8, plane, x, y) \
+					(((chip8)->gfx[plane][y][(x) / 64] >> (63 - (x) % 64)) & 1)
+
+/* mark the memory block holding a (wrapped) address dirty */
+#define CHIP8_MEM_DIRTY(chip8, addr)	((chip8)->mem_dirty[(addr) / CHIP8_MEMORY_BLOCK_SIZE / 64] |= \
+					 1ULL << ((addr) / CHIP8_MEMORY_BLOCK_SIZE % 64))
 
 /*
  * Chip8 structure.
+ *
+ * The execution context (registers and everything read or written by most instructions)
+ * fills the first cache line. Stack, audio and RPL state follow in a second one. Memory,
+ * display and keypad are separate regions, allocated by chip8_create() (memory may come
+ * from a caller arena) : copying or resetting a machine doesn't move them as a whole.
+ * Memory is sized for the quirks profile : 4 KB for COSMAC VIP and SUPER-CHIP, 64 KB for XO-CHIP.
  */
 struct chip8_t {
-	uint16_t	stack[CHIP8_STACK_SIZE];	/* stack */
-	uint16_t	sp;				/* stack pointer */
-	uint8_t		V[CHIP8_NR_REGISTERS];		/* registers */
-	uint8_t		memory[CHIP8_MEMORY_SIZE];	/* memory */
+	/* execution context (cache line 0) */
+	_Alignas(CHIP8_CACHE_LINE) uint8_t V[CHIP8_NR_REGISTERS];	/* registers */
 	uint16_t	pc;				/* program counter */
 	uint16_t	I;				/* index register */
+	uint16_t	sp;				/* stack pointer */
 	uint8_t		delay_timer;			/* delay timer */
 	uint8_t		sound_timer;			/* sound timer */
-	uint8_t		gfx[CHIP8_GFX_SIZE];		/* graphics buffer */
-	uint8_t		key[CHIP8_NR_KEYS];		/* keypad */
+	uint16_t	timer_us;			/* emulated time since last timers update */
+	uint16_t	mem_mask;			/* addressable memory size - 1 */
+	uint32_t	rng;				/* random generator state */
+	uint8_t		quirks;				/* quirks (CHIP8_QUIRK_*) */
+	uint8_t		timing;				/* timing mode (CHIP8_TIMING_*) */
+	uint8_t		display_wait;			/* 1 if waiting for next frame after a draw */
+	uint8_t		hires;				/* 1 if display is in 128x64 mode */
+	uint8_t		planes;				/* selected planes bitmask */
 	char		draw_flag;			/* draw flag : 1 if screen is dirty */
+	char		gfx_dirty;			/* 1 if gfx changed since last reset */
+	int32_t		cycle_budget;			/* VIP cycles left in current frame (negative = overrun) */
+	uint32_t	frames;				/* emulated 60 Hz frames */
+	uint64_t	cycles;				/* emulated cycles (instructions in fixed timing, machine cycles in VIP timing) */
+	uint8_t *	memory;				/* memory region (mem_size bytes) */
+
+	/* stack, display and keypad regions, audio, RPL (cache line 1) */
+	_Alignas(CHIP8_CACHE_LINE) uint16_t stack[CHIP8_STACK_SIZE];	/* stack */
+	uint64_t	(*gfx)[CHIP8_GFX_HIRES_HEIGHT][CHIP8_GFX_ROW_WORDS];	/* display region : graphics planes */
+	uint8_t *	key;				/* keypad region (CHIP8_NR_KEYS bytes) */
+	uint8_t		pattern[CHIP8_AUDIO_PATTERN_SIZE];	/* XO-CHIP audio pattern (1 bit samples) */
+
+	/* cold state (cache line 2) */
+	uint8_t		rpl[CHIP8_NR_RPL];		/* RPL user flags */
+	uint8_t		pitch;				/* XO-CHIP audio pattern pitch */
+	char		pattern_flag;			/* 1 if a pattern was loaded (else beeper) */
+	char		arena_memory;			/* 1 if memory comes from a caller arena */
+	uint32_t	mem_size;			/* memory region size */
+	uint64_t	mem_dirty[(CHIP8_MEMORY_NR_BLOCKS + 63) / 64];	/* memory blocks changed since last reset */
+};
+
+/*
+ * Caller provided arena : memory regions of many machines in one allocation.
+ */
+struct chip8_arena_t {
+	uint8_t *	base;				/* arena start */
+	size_t		size;				/* arena size */
+	size_t		used;				/* bytes allocated */
+};
+
+/*
+ * Machine snapshot : a copy of the context and regions (memory blocks clean at save time are not copied).
+ * Memory is allocated by chip8_state_init() for the machine size : snapshots of a machine can only be
+ * loaded into machines of the same memory size.
+ */
+struct chip8_state_t {
+	struct chip8_t	ctx;				/* context (region pointers unused) */
+	uint64_t	gfx[CHIP8_GFX_NR_PLANES][CHIP8_GFX_HIRES_HEIGHT][CHIP8_GFX_ROW_WORDS];	/* graphics planes */
+	uint8_t		key[CHIP8_NR_KEYS];		/* keypad */
+	uint8_t *	memory;				/* memory (dirty blocks only) */
+	uint32_t	mem_size;			/* memory size */
 };
 
+/*
+ * Region accessors for front ends and tools.
+ */
+
+/* memory at a (wrapped) address */
+static inline uint8_t *chip8_mem(const struct chip8_t *chip8, uint32_t addr)
+{
+	return &chip8->memory[CHIP8_ADDR(chip8, addr)];
+}
+
+/* display row of a plane (CHIP8_GFX_ROW_WORDS words) : row 0 of plane 0 starts the whole display (CHIP8_GFX_SIZE bytes) */
+static inline uint64_t *chip8_gfx_row(const struct chip8_t *chip8, int plane, int y)
+{
+	return chip8->gfx[plane][y];
+}
+
+/* get key state */
+static inline uint8_t chip8_key(const struct chip8_t *chip8, uint8_t key)
+{
+	return chip8->key[key & (CHIP8_NR_KEYS - 1)];
+}
+
+/* press or release a key */
+static inline void chip8_key_set(struct chip8_t *chip8, uint8_t key, int pressed)
+{
+	chip8->key[key & (CHIP8_NR_KEYS - 1)] = pressed != 0;
+}
+
 extern uint8_t chip8_keymap[];
+extern uint8_t chip8_palette[];
 
 /* prototypes */
+void chip8_arena_init(struct chip8_arena_t *arena, void *buf, size_t size);
+struct chip8_t *chip8_create(struct chip8_arena_t *arena, uint8_t quirks);
+void chip8_destroy(struct chip8_t *chip8);
 void chip8_init(struct chip8_t *chip8);
+void chip8_reset(struct chip8_t *chip8);
+void chip8_seed(struct chip8_t *chip8, uint32_t seed);
+int chip8_set_quirks(struct chip8_t *chip8, uint8_t quirks);
+int chip8_profile(const char *name);
+void chip8_set_timing(struct chip8_t *chip8, uint8_t timing);
+int chip8_timing(const char *name);
+int chip8_state_init(struct chip8_state_t *state, const struct chip8_t *chip8);
+void chip8_state_free(struct chip8_state_t *state);
+void chip8_save_state(const struct chip8_t *chip8, struct chip8_state_t *state);
+void chip8_load_state(struct chip8_t *chip8, const struct chip8_state_t *state);
 int chip8_load_rom(struct chip8_t *chip8, const char *path);
+int chip8_load_rom_buffer(struct chip8_t *chip8, const uint8_t *buf, size_t size);
 int chip8_tick(struct chip8_t *chip8);
+int chip8_run_frame(struct chip8_t *chip8);
+double chip8_cycles_per_second(const struct chip8_t *chip8);
+uint32_t chip8_vip_cycles(const struct chip8_t *chip8, uint16_t opcode);
 
 /* instructions */
 void chip8_clear_screen(struct chip8_t *chip8);
@@ -56,19 +213,34 @@ void chip8_and_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y);
 void chip8_xor_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y);
 void chip8_add_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y);
 void chip8_sub_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y);
-void chip8_rshift_reg(struct chip8_t *chip8, uint8_t x);
-void chip8_lshift_reg(struct chip8_t *chip8, uint8_t x);
+void chip8_rshift_reg(struct chip8_t *chip8, uint8_t x, uint8_t y);
+void chip8_lshift_reg(struct chip8_t *chip8, uint8_t x, uint8_t y);
 void chip8_sub_reg_reg_inv(struct chip8_t *chip8, uint8_t x, uint8_t y);
 void chip8_set_I(struct chip8_t *chip8, uint16_t addr);
 void chip8_jump_plus_v0(struct chip8_t *chip8, uint16_t addr);
 void chip8_rand(struct chip8_t *chip8, uint8_t x, uint8_t val);
 void chip8_draw(struct chip8_t *chip8, uint8_t x, uint8_t y, uint8_t height);
+void chip8_scroll_down(struct chip8_t *chip8, uint8_t n);
+void chip8_scroll_up(struct chip8_t *chip8, uint8_t n);
+void chip8_scroll_right(struct chip8_t *chip8);
+void chip8_scroll_left(struct chip8_t *chip8);
+void chip8_exit(struct chip8_t *chip8);
+void chip8_set_hires(struct chip8_t *chip8, uint8_t hires);
+void chip8_reg_save_range(struct chip8_t *chip8, uint8_t x, uint8_t y);
+void chip8_reg_load_range(struct chip8_t *chip8, uint8_t x, uint8_t y);
+void chip8_set_I_long(struct chip8_t *chip8);
+void chip8_select_planes(struct chip8_t *chip8, uint8_t n);
+void chip8_bigsprite_addr(struct chip8_t *chip8, uint8_t x);
+void chip8_rpl_save(struct chip8_t *chip8, uint8_t x);
+void chip8_rpl_load(struct chip8_t *chip8, uint8_t x);
 void chip8_skip_if_key_pressed(struct chip8_t *chip8, uint8_t x);
 void chip8_skip_if_key_not_pressed(struct chip8_t *chip8, uint8_t x);
 void chip8_get_delay(struct chip8_t *chip8, uint8_t x);
 void chip8_get_key(struct chip8_t *chip8, uint8_t x);
 void chip8_set_delay_timer(struct chip8_t *chip8, uint8_t x);
 void chip8_set_sound_timer(struct chip8_t *chip8, uint8_t x);
+void chip8_load_pattern(struct chip8_t *chip8);
+void chip8_set_pitch(struct chip8_t *chip8, uint8_t x);
 void chip8_add_vx_to_i(struct chip8_t *chip8, uint8_t x);
 void chip8_sprite_addr(struct chip8_t *chip8, uint8_t x);
 void chip8_bcd(struct chip8_t *chip8, uint8_t x);
@@ -0,0 +1,394 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+
+#include "chip8_audio.h"
+
+#define WAV_HEADER_SIZE		44
+
+/*
+ * Push samples in the ring buffer (producer side). Never blocks : samples above max_fill queued samples are dropped.
+ */
+static size_t chip8_audio_ring_write(struct chip8_audio_ring_t *ring, const int16_t *samples, size_t n, size_t max_fill)
+{
+	size_t head, tail, i;
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	/* limit to free space below max_fill */
+	if (head - tail >= max_fill)
+		n = 0;
+	else if (n > max_fill - (head - tail))
+		n = max_fill - (head - tail);
+
+	for (i = 0; i < n; i++)
+		ring->buf[(head + i) & (CHIP8_AUDIO_RING_SIZE - 1)] = samples[i];
+
+	atomic_store_explicit(&ring->head, head + n, memory_order_release);
+	return n;
+}
+
+/*
+ * Pop samples from the ring buffer (consumer side).
+ */
+static size_t chip8_audio_ring_read(struct chip8_audio_ring_t *ring, int16_t *samples, size_t n)
+{
+	size_t head, tail, i;
+
+	tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	/* limit to available samples */
+	if (n > head - tail)
+		n = head - tail;
+
+	for (i = 0; i < n; i++)
+		samples[i] = ring->buf[(tail + i) & (CHIP8_AUDIO_RING_SIZE - 1)];
+
+	atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+	return n;
+}
+
+/*
+ * Init audio synthesizer.
+ */
+void chip8_audio_init(struct chip8_audio_t *audio, uint32_t rate)
+{
+	memset(audio, 0, sizeof(struct chip8_audio_t));
+	atomic_init(&audio->ring.head, 0);
+	atomic_init(&audio->ring.tail, 0);
+
+	audio->rate = rate;
+	audio->beep_step = (uint32_t) (((uint64_t) CHIP8_AUDIO_BEEP_FREQ << 32) / rate);
+
+	/* bound latency : never queue more than CHIP8_AUDIO_MAX_FILL_US of samples */
+	audio->max_fill = (uint64_t) CHIP8_AUDIO_MAX_FILL_US * rate / 1000000;
+	if (audio->max_fill > CHIP8_AUDIO_RING_SIZE)
+		audio->max_fill = CHIP8_AUDIO_RING_SIZE;
+}
+
+/*
+ * Generate samples for us microseconds of emulated time.
+ */
+void chip8_audio_tick(struct chip8_audio_t *audio, struct chip8_t *chip8, uint32_t us)
+{
+	int16_t samples[256];
+	size_t n, i, count;
+	uint32_t bit;
+
+	/* number of samples matching emulated time */
+	audio->time_acc += (uint64_t) us * audio->rate;
+	n = audio->time_acc / 1000000;
+	audio->time_acc %= 1000000;
+
+	/* pattern playback rate = 4000 * 2^((pitch - 64) / 48) bits/s, 128 bits per period */
+	if (chip8->pattern_flag && (!audio->pattern_step || chip8->pitch != audio->pattern_pitch)) {
+		audio->pattern_step = (uint32_t) (4000.0 * pow(2.0, (chip8->pitch - 64) / 48.0) / 128.0 * 4294967296.0 / audio->rate);
+		audio->pattern_pitch = chip8->pitch;
+	}
+
+	while (n > 0) {
+		count = n < sizeof(samples) / sizeof(samples[0]) ? n : sizeof(samples) / sizeof(samples[0]);
+
+		for (i = 0; i < count; i++) {
+			if (!chip8->sound_timer) {
+				samples[i] = 0;
+				continue;
+			}
+
+			if (chip8->pattern_flag) {
+				/* XO-CHIP : play the 128 bits pattern */
+				bit = audio->phase >> 25;
+				samples[i] = (chip8->pattern[bit >> 3] >> (7 - (bit & 7))) & 1 ? CHIP8_AUDIO_AMPLITUDE : -CHIP8_AUDIO_AMPLITUDE;
+				audio->phase += audio->pattern_step;
+			} else {
+				/* beeper : square wave */
+				samples[i] = audio->phase & 0x80000000 ? CHIP8_AUDIO_AMPLITUDE : -CHIP8_AUDIO_AMPLITUDE;
+				audio->phase += audio->beep_step;
+			}
+		}
+
+		audio->dropped += count - chip8_audio_ring_write(&audio->ring, samples, count, audio->max_fill);
+		n -= count;
+	}
+}
+
+/*
+ * Read samples (consumer side).
+ */
+size_t chip8_audio_read(struct chip8_audio_t *audio, int16_t *samples, size_t n)
+{
+	return chip8_audio_ring_read(&audio->ring, samples, n);
+}
+
+/*
+ * Drain all available samples into a sink (consumer side).
+ */
+size_t chip8_audio_drain(struct chip8_audio_t *audio, struct chip8_audio_sink_t *sink)
+{
+	int16_t samples[CHIP8_AUDIO_RING_SIZE];
+	size_t n, total = 0;
+
+	while ((n = chip8_audio_ring_read(&audio->ring, samples, CHIP8_AUDIO_RING_SIZE)) > 0) {
+		if (sink->write(sink, samples, n))
+			break;
+
+		total += n;
+	}
+
+	return total;
+}
+
+/*
+ * Write a little endian integer.
+ */
+static void wav_put(uint8_t *buf, uint32_t val, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = val >> (8 * i);
+}
+
+/*
+ * Write WAV header (mono, 16 bits).
+ */
+static int wav_write_header(struct chip8_audio_sink_t *sink)
+{
+	uint32_t data_size = sink->nr_samples * sizeof(int16_t);
+	uint8_t header[WAV_HEADER_SIZE];
+
+	memcpy(header, "RIFF", 4);
+	wav_put(header + 4, 36 + data_size, 4);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	wav_put(header + 16, 16, 4);
+	wav_put(header + 20, 1, 2);
+	wav_put(header + 22, 1, 2);
+	wav_put(header + 24, sink->rate, 4);
+	wav_put(header + 28, sink->rate * sizeof(int16_t), 4);
+	wav_put(header + 32, sizeof(int16_t), 2);
+	wav_put(header + 34, 16, 2);
+	memcpy(header + 36, "data", 4);
+	wav_put(header + 40, data_size, 4);
+
+	return fwrite(header, WAV_HEADER_SIZE, 1, sink->fp) == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Write samples to a WAV sink.
+ */
+static int wav_write(struct chip8_audio_sink_t *sink, const int16_t *samples, size_t n)
+{
+	uint8_t buf[2 * CHIP8_AUDIO_RING_SIZE];
+	size_t i, count;
+
+	while (n > 0) {
+		count = n < CHIP8_AUDIO_RING_SIZE ? n : CHIP8_AUDIO_RING_SIZE;
+
+		for (i = 0; i < count; i++)
+			wav_put(buf + 2 * i, (uint16_t) samples[i], 2);
+
+		if (fwrite(buf, 2, count, sink->fp) != count)
+			return EXIT_FAILURE;
+
+		sink->nr_samples += count;
+		samples += count;
+		n -= count;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Close a WAV sink (patch sizes in header if output is seekable).
+ */
+static void wav_close(struct chip8_audio_sink_t *sink)
+{
+	if (fseek(sink->fp, 0, SEEK_SET) == 0)
+		wav_write_header(sink);
+
+	fclose(sink->fp);
+	free(sink);
+}
+
+/*
+ * Create a WAV file sink.
+ */
+struct chip8_audio_sink_t *chip8_audio_sink_wav(const char *path, uint32_t rate)
+{
+	struct chip8_audio_sink_t *sink;
+
+	sink = (struct chip8_audio_sink_t *) calloc(1, sizeof(struct chip8_audio_sink_t));
+	if (!sink)
+		return NULL;
+
+	sink->write = wav_write;
+	sink->close = wav_close;
+	sink->rate = rate;
+
+	/* open output */
+	sink->fp = fopen(path, "wb");
+	if (!sink->fp)
+		goto err;
+
+	/* write temporary header */
+	if (wav_write_header(sink))
+		goto err;
+
+	return sink;
+err:
+	if (sink->fp)
+		fclose(sink->fp);
+	free(sink);
+	return NULL;
+}
+
+/*
+ * Write samples to the null sink.
+ */
+static int null_write(struct chip8_audio_sink_t *sink, const int16_t *samples, size_t n)
+{
+	(void) samples;
+	sink->nr_samples += n;
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Close the null sink.
+ */
+static void null_close(struct chip8_audio_sink_t *sink)
+{
+	free(sink);
+}
+
+/*
+ * Create a null sink (discards samples).
+ */
+struct chip8_audio_sink_t *chip8_audio_sink_null(uint32_t rate)
+{
+	struct chip8_audio_sink_t *sink;
+
+	sink = (struct chip8_audio_sink_t *) calloc(1, sizeof(struct chip8_audio_sink_t));
+	if (!sink)
+		return NULL;
+
+	sink->write = null_write;
+	sink->close = null_close;
+	sink->rate = rate;
+
+	return sink;
+}
+
+/*
+ * Write samples to an ALSA sink (blocks while the device buffer is full).
+ */
+static int alsa_write(struct chip8_audio_sink_t *sink, const int16_t *samples, size_t n)
+{
+	snd_pcm_sframes_t ret;
+
+	while (n > 0) {
+		ret = snd_pcm_writei((snd_pcm_t *) sink->pcm, samples, n);
+
+		/* underrun (ring was empty) or suspend : recover and retry */
+		if (ret < 0) {
+			if (snd_pcm_recover((snd_pcm_t *) sink->pcm, (int) ret, 1) < 0)
+				return EXIT_FAILURE;
+			continue;
+		}
+
+		sink->nr_samples += ret;
+		samples += ret;
+		n -= ret;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Close an ALSA sink (plays remaining samples).
+ */
+static void alsa_close(struct chip8_audio_sink_t *sink)
+{
+	snd_pcm_drain((snd_pcm_t *) sink->pcm);
+	snd_pcm_close((snd_pcm_t *) sink->pcm);
+	free(sink);
+}
+
+/*
+ * Create an ALSA sound device sink (mono, 16 bits).
+ */
+struct chip8_audio_sink_t *chip8_audio_sink_alsa(const char *device, uint32_t rate)
+{
+	struct chip8_audio_sink_t *sink;
+	snd_pcm_t *pcm;
+
+	sink = (struct chip8_audio_sink_t *) calloc(1, sizeof(struct chip8_audio_sink_t));
+	if (!sink)
+		return NULL;
+
+	sink->write = alsa_write;
+	sink->close = alsa_close;
+	sink->rate = rate;
+
+	/* open device */
+	if (snd_pcm_open(&pcm, device, SND_PCM_STREAM_PLAYBACK, 0) < 0)
+		goto err;
+
+	/* device resamples if needed */
+	if (snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED, 1, rate, 1, CHIP8_AUDIO_DEVICE_LATENCY_US) < 0) {
+		snd_pcm_close(pcm);
+		goto err;
+	}
+
+	sink->pcm = pcm;
+	return sink;
+err:
+	free(sink);
+	return NULL;
+}
+
+/*
+ * Backend drain thread.
+ */
+static void *chip8_audio_backend_thread(void *arg)
+{
+	struct chip8_audio_backend_t *backend = (struct chip8_audio_backend_t *) arg;
+	struct timespec ts = { 0, CHIP8_AUDIO_DRAIN_US * 1000 };
+
+	while (atomic_load(&backend->running)) {
+		chip8_audio_drain(backend->audio, backend->sink);
+		nanosleep(&ts, NULL);
+	}
+
+	/* drain remaining samples */
+	chip8_audio_drain(backend->audio, backend->sink);
+
+	return NULL;
+}
+
+/*
+ * Start audio backend.
+ */
+int chip8_audio_backend_start(struct chip8_audio_backend_t *backend, struct chip8_audio_t *audio, struct chip8_audio_sink_t *sink)
+{
+	backend->audio = audio;
+	backend->sink = sink;
+	atomic_init(&backend->running, 1);
+
+	if (pthread_create(&backend->thread, NULL, chip8_audio_backend_thread, backend))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Stop audio backend.
+ */
+void chip8_audio_backend_stop(struct chip8_audio_backend_t *backend)
+{
+	atomic_store(&backend->running, 0);
+	pthread_join(backend->thread, NULL);
+}
@@ -0,0 +1,86 @@
+#ifndef _CHIP8_AUDIO_H_
+#define _CHIP8_AUDIO_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "chip8.h"
+
+/*
+ * Output latency : the sound device buffer holds one frame and the ring never queues more than 1.5 frames
+ * (samples above are dropped, half a frame of slack absorbs frame timer jitter), so with the drain period
+ * a sample is heard at most ~45 ms (under 3 frames) after the emulated frame that produced it.
+ */
+#define CHIP8_AUDIO_RATE		44100
+#define CHIP8_AUDIO_RING_SIZE		2048		/* power of 2 : ~46 ms at 44.1 kHz */
+#define CHIP8_AUDIO_BEEP_FREQ		440
+#define CHIP8_AUDIO_AMPLITUDE		8000
+#define CHIP8_AUDIO_DRAIN_US		2000
+#define CHIP8_AUDIO_MAX_FILL_US		(CHIP8_FRAME_FREQ_US * 3 / 2)	/* ring fill cap */
+#define CHIP8_AUDIO_DEVICE_LATENCY_US	CHIP8_FRAME_FREQ_US		/* sound device buffer */
+#define CHIP8_AUDIO_DEFAULT_DEVICE	"default"
+
+/*
+ * Single producer / single consumer lock-free ring buffer.
+ */
+struct chip8_audio_ring_t {
+	_Alignas(64) atomic_size_t	head;				/* next write index (producer) */
+	_Alignas(64) atomic_size_t	tail;				/* next read index (consumer) */
+	_Alignas(64) int16_t		buf[CHIP8_AUDIO_RING_SIZE];	/* samples */
+};
+
+/*
+ * Audio synthesizer : produces samples aligned to emulated time.
+ */
+struct chip8_audio_t {
+	struct chip8_audio_ring_t	ring;			/* output samples */
+	uint32_t			rate;			/* sample rate */
+	uint64_t			time_acc;		/* emulated time not yet converted to samples (us * rate) */
+	uint32_t			phase;			/* waveform phase (fixed point, 2^32 = 1 period) */
+	uint32_t			beep_step;		/* beeper phase step per sample */
+	uint32_t			pattern_step;		/* pattern phase step per sample */
+	uint8_t				pattern_pitch;		/* pitch pattern_step was computed for */
+	size_t				max_fill;		/* ring fill cap (samples) */
+	uint64_t			dropped;		/* samples dropped because ring reached max_fill */
+};
+
+/*
+ * Audio sink.
+ */
+struct chip8_audio_sink_t {
+	int				(*write)(struct chip8_audio_sink_t *sink, const int16_t *samples, size_t n);
+	void				(*close)(struct chip8_audio_sink_t *sink);
+	FILE *				fp;			/* output file (wav sink) */
+	void *				pcm;			/* PCM device (alsa sink) */
+	uint32_t			rate;			/* sample rate */
+	uint64_t			nr_samples;		/* number of samples written */
+};
+
+/*
+ * Audio backend : drains the ring buffer into a sink from its own thread.
+ */
+struct chip8_audio_backend_t {
+	struct chip8_audio_t *		audio;			/* audio synthesizer */
+	struct chip8_audio_sink_t *	sink;			/* output sink */
+	pthread_t			thread;			/* drain thread */
+	atomic_int			running;		/* 0 to stop drain thread */
+};
+
+/* synthesizer */
+void chip8_audio_init(struct chip8_audio_t *audio, uint32_t rate);
+void chip8_audio_tick(struct chip8_audio_t *audio, struct chip8_t *chip8, uint32_t us);
+size_t chip8_audio_read(struct chip8_audio_t *audio, int16_t *samples, size_t n);
+size_t chip8_audio_drain(struct chip8_audio_t *audio, struct chip8_audio_sink_t *sink);
+
+/* sinks */
+struct chip8_audio_sink_t *chip8_audio_sink_wav(const char *path, uint32_t rate);
+struct chip8_audio_sink_t *chip8_audio_sink_null(uint32_t rate);
+struct chip8_audio_sink_t *chip8_audio_sink_alsa(const char *device, uint32_t rate);
+
+/* backend */
+int chip8_audio_backend_start(struct chip8_audio_backend_t *backend, struct chip8_audio_t *audio, struct chip8_audio_sink_t *sink);
+void chip8_audio_backend_stop(struct chip8_audio_backend_t *backend);
+
+#endif
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_capture.h"
+
+/*
+ * Convert a display row to output pixels.
+ */
+static void chip8_capture_row(struct chip8_capture_t *cap, struct chip8_t *chip8, int y)
+{
+	int x, p, scale = chip8->hires ? 1 : 2;
+	uint8_t val, *out;
+
+	for (x = 0; x < CHIP8_GFX_WIDTH(chip8); x++) {
+		/* get pixel value */
+		for (p = 0, val = 0; p < CHIP8_GFX_NR_PLANES; p++)
+			val |= CHIP8_GFX_PIXEL(chip8, p, x, y) << p;
+		val = chip8_palette[val];
+
+		/* write scale x scale output pixels */
+		if (cap->format == CHIP8_CAPTURE_RGB) {
+			out = cap->frame + (y * scale * CHIP8_CAPTURE_WIDTH + x * scale) * 3;
+			memset(out, val, scale * 3);
+			if (scale == 2)
+				memset(out + CHIP8_CAPTURE_WIDTH * 3, val, scale * 3);
+		} else {
+			out = cap->frame + y * scale * CHIP8_CAPTURE_WIDTH + x * scale;
+			memset(out, val, scale);
+			if (scale == 2)
+				memset(out + CHIP8_CAPTURE_WIDTH, val, scale);
+		}
+	}
+}
+
+/*
+ * Open a capture output ("-" = standard output).
+ * With an index, repeated frames are not written : the index gets the timestamp of each written frame
+ * (Matroska timecodes v2, e.g. mkvmerge --timestamps 0:<index>), as Y4M and raw video have a fixed frame rate.
+ */
+struct chip8_capture_t *chip8_capture_open(const char *path, enum chip8_capture_format_t format, const char *index_path)
+{
+	struct chip8_capture_t *cap;
+
+	cap = (struct chip8_capture_t *) calloc(1, sizeof(struct chip8_capture_t));
+	if (!cap)
+		return NULL;
+
+	cap->format = format;
+	cap->frame_size = CHIP8_CAPTURE_WIDTH * CHIP8_CAPTURE_HEIGHT * (format == CHIP8_CAPTURE_RGB ? 3 : 1);
+
+	/* open output */
+	cap->fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+	if (!cap->fp)
+		goto err;
+
+	/* large buffer : the emulator never waits on small writes */
+	cap->buffer = (char *) malloc(CHIP8_CAPTURE_BUFFER_SIZE);
+	if (cap->buffer)
+		setvbuf(cap->fp, cap->buffer, _IOFBF, CHIP8_CAPTURE_BUFFER_SIZE);
+
+	/* write stream header */
+	if (format == CHIP8_CAPTURE_Y4M
+	    && fprintf(cap->fp, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n",
+		       CHIP8_CAPTURE_WIDTH, CHIP8_CAPTURE_HEIGHT, CHIP8_CAPTURE_FPS) < 0)
+		goto err;
+
+	/* open index */
+	if (index_path) {
+		cap->index = fopen(index_path, "w");
+		if (!cap->index || fputs("# timestamp format v2\n", cap->index) < 0)
+			goto err;
+	}
+
+	return cap;
+err:
+	if (cap->index)
+		fclose(cap->index);
+	if (cap->fp && cap->fp != stdout)
+		fclose(cap->fp);
+	free(cap->buffer);
+	free(cap);
+	return NULL;
+}
+
+/*
+ * Capture a frame. Only rows that changed since the last frame are converted,
+ * and the previous frame is written again if nothing changed (skipped with an index).
+ * If draw_flag is clear, the display is assumed unchanged (caller clears draw_flag after each frame).
+ */
+int chip8_capture_frame(struct chip8_capture_t *cap, struct chip8_t *chip8)
+{
+	int y, p, changed = 0, all = 0;
+
+	/* display mode changed : convert all rows */
+	if (!cap->nr_frames || chip8->hires != cap->hires) {
+		cap->hires = chip8->hires;
+		all = 1;
+	}
+
+	/* convert changed rows */
+	if (all || chip8->draw_flag) {
+		for (y = 0; y < CHIP8_GFX_HEIGHT(chip8); y++) {
+			for (p = 0; p < CHIP8_GFX_NR_PLANES; p++)
+				if (memcmp(cap->rows[y][p], chip8_gfx_row(chip8, p, y), sizeof(cap->rows[y][p])))
+					break;
+
+			if (!all && p == CHIP8_GFX_NR_PLANES)
+				continue;
+
+			for (p = 0; p < CHIP8_GFX_NR_PLANES; p++)
+				memcpy(cap->rows[y][p], chip8_gfx_row(chip8, p, y), sizeof(cap->rows[y][p]));
+
+			chip8_capture_row(cap, chip8, y);
+			changed = 1;
+		}
+	}
+
+	if (!changed) {
+		cap->nr_repeats++;
+
+		/* previous frame lasts until the next written one */
+		if (cap->index) {
+			cap->nr_frames++;
+			return EXIT_SUCCESS;
+		}
+	}
+
+	/* write timestamp (ms) */
+	if (cap->index && fprintf(cap->index, "%.3f\n", cap->nr_frames * 1000.0 / CHIP8_CAPTURE_FPS) < 0)
+		return EXIT_FAILURE;
+
+	/* write frame */
+	if (cap->format == CHIP8_CAPTURE_Y4M && fputs("FRAME\n", cap->fp) < 0)
+		return EXIT_FAILURE;
+	if (fwrite(cap->frame, cap->frame_size, 1, cap->fp) != 1)
+		return EXIT_FAILURE;
+
+	cap->nr_frames++;
+	cap->nr_written++;
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Close capture (buffered frames may only fail to write here).
+ */
+int chip8_capture_close(struct chip8_capture_t *cap)
+{
+	int ret = 0;
+
+	if (cap->index)
+		ret |= fclose(cap->index);
+
+	/* stdout keeps using its buffer until exit */
+	if (cap->fp == stdout) {
+		ret |= fflush(cap->fp);
+	} else {
+		ret |= fclose(cap->fp);
+		free(cap->buffer);
+	}
+
+	free(cap);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
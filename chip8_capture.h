@@ -0,0 +1,43 @@
+#ifndef _CHIP8_CAPTURE_H_
+#define _CHIP8_CAPTURE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define CHIP8_CAPTURE_WIDTH		CHIP8_GFX_HIRES_WIDTH
+#define CHIP8_CAPTURE_HEIGHT		CHIP8_GFX_HIRES_HEIGHT
+#define CHIP8_CAPTURE_FPS		60
+#define CHIP8_CAPTURE_BUFFER_SIZE	(1024 * 1024)
+
+/*
+ * Capture formats.
+ */
+enum chip8_capture_format_t {
+	CHIP8_CAPTURE_RGB,			/* raw RGB24, 128x64 */
+	CHIP8_CAPTURE_Y4M,			/* YUV4MPEG2, 128x64 monochrome */
+};
+
+/*
+ * Video capture.
+ */
+struct chip8_capture_t {
+	FILE *				fp;						/* output */
+	FILE *				index;						/* timecodes (NULL = repeats are written) */
+	enum chip8_capture_format_t	format;						/* output format */
+	size_t				frame_size;					/* output frame size */
+	uint8_t				frame[CHIP8_CAPTURE_WIDTH * CHIP8_CAPTURE_HEIGHT * 3];	/* last output frame */
+	uint64_t			rows[CHIP8_GFX_HIRES_HEIGHT][CHIP8_GFX_NR_PLANES][CHIP8_GFX_ROW_WORDS];	/* last captured display rows */
+	uint8_t				hires;						/* last captured display mode */
+	uint64_t			nr_frames;					/* number of frames captured */
+	uint64_t			nr_repeats;					/* number of repeated frames */
+	uint64_t			nr_written;					/* number of frames written */
+	char *				buffer;						/* stdio buffer */
+};
+
+struct chip8_capture_t *chip8_capture_open(const char *path, enum chip8_capture_format_t format, const char *index_path);
+int chip8_capture_frame(struct chip8_capture_t *cap, struct chip8_t *chip8);
+int chip8_capture_close(struct chip8_capture_t *cap);
+
+#endif
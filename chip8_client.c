@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "chip8.h"
+#include "chip8_proto.h"
+
+#define IN_SIZE			(2 * CHIP8_PROTO_MAX_FRAME_SIZE)
+
+/*
+ * Thin client : display reconstructed from server deltas.
+ */
+struct client_t {
+	int		fd;						/* socket */
+	uint32_t	session;					/* attached session */
+	uint32_t	frame;						/* last frame number */
+	int		hires;						/* display mode */
+	uint8_t		rows[CHIP8_GFX_HIRES_HEIGHT][CHIP8_PROTO_ROW_SIZE];	/* display rows */
+	uint8_t		in[IN_SIZE];					/* input buffer */
+	size_t		in_len;						/* input buffer length */
+	uint64_t	nr_frames;					/* frames received */
+	uint64_t	nr_bytes;					/* bytes received */
+};
+
+/*
+ * Send a message.
+ */
+static int client_send(struct client_t *client, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+	uint8_t msg[CHIP8_PROTO_HEADER_SIZE + 4];
+
+	msg[0] = type;
+	chip8_proto_put16(msg + 1, len);
+	memcpy(msg + CHIP8_PROTO_HEADER_SIZE, payload, len);
+
+	return send(client->fd, msg, CHIP8_PROTO_HEADER_SIZE + len, 0) == CHIP8_PROTO_HEADER_SIZE + len ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Print display.
+ */
+static void client_print(struct client_t *client, int clear)
+{
+	int x, y, p, val, width, height;
+
+	width = client->hires ? CHIP8_GFX_HIRES_WIDTH : CHIP8_GFX_LORES_WIDTH;
+	height = client->hires ? CHIP8_GFX_HIRES_HEIGHT : CHIP8_GFX_LORES_HEIGHT;
+
+	if (clear)
+		printf("\033[H");
+
+	printf("session %u frame %u\n", client->session, client->frame);
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			for (p = 0, val = 0; p < CHIP8_GFX_NR_PLANES; p++)
+				val |= ((client->rows[y][p * CHIP8_PROTO_PLANE_ROW_SIZE + x / 8] >> (7 - x % 8)) & 1) << p;
+			putchar(" #+*"[val]);
+		}
+		putchar('\n');
+	}
+
+	fflush(stdout);
+}
+
+/*
+ * Handle a frame message.
+ */
+static int client_frame(struct client_t *client, const uint8_t *payload, size_t len)
+{
+	size_t pos = 6, row_len;
+	int i, nr_rows;
+
+	if (len < 6)
+		return EXIT_FAILURE;
+
+	client->frame = chip8_proto_get32(payload);
+	client->hires = payload[4];
+	nr_rows = payload[5];
+
+	for (i = 0; i < nr_rows; i++) {
+		if (pos + 2 > len)
+			return EXIT_FAILURE;
+
+		row_len = payload[pos + 1];
+		if (payload[pos] >= CHIP8_GFX_HIRES_HEIGHT || pos + 2 + row_len > len)
+			return EXIT_FAILURE;
+
+		if (chip8_proto_decode_row(payload + pos + 2, row_len, client->rows[payload[pos]]))
+			return EXIT_FAILURE;
+
+		pos += 2 + row_len;
+	}
+
+	client->nr_frames++;
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Read and handle server messages.
+ */
+static int client_read(struct client_t *client)
+{
+	size_t pos, len;
+	uint8_t *msg;
+	ssize_t n;
+
+	n = recv(client->fd, client->in + client->in_len, IN_SIZE - client->in_len, 0);
+	if (n <= 0)
+		return EXIT_FAILURE;
+
+	client->in_len += n;
+	client->nr_bytes += n;
+
+	for (pos = 0; client->in_len - pos >= CHIP8_PROTO_HEADER_SIZE; pos += CHIP8_PROTO_HEADER_SIZE + len) {
+		msg = client->in + pos;
+		len = chip8_proto_get16(msg + 1);
+		if (CHIP8_PROTO_HEADER_SIZE + len > IN_SIZE)
+			return EXIT_FAILURE;
+		if (client->in_len - pos < CHIP8_PROTO_HEADER_SIZE + len)
+			break;
+
+		switch (msg[0]) {
+			case CHIP8_PROTO_SESSION:
+				if (len != 4)
+					return EXIT_FAILURE;
+				client->session = chip8_proto_get32(msg + 3);
+				break;
+			case CHIP8_PROTO_FRAME:
+				if (client_frame(client, msg + 3, len))
+					return EXIT_FAILURE;
+				break;
+			default:
+				return EXIT_FAILURE;
+		}
+	}
+
+	memmove(client->in, client->in + pos, client->in_len - pos);
+	client->in_len -= pos;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Main.
+ */
+int main(int argc, char **argv)
+{
+	uint32_t session = CHIP8_PROTO_NEW_SESSION;
+	static struct client_t client;
+	int opt, quiet = 0, one = 1, ret = EXIT_SUCCESS;
+	unsigned int key, pressed;
+	long max_frames = -1;
+	struct sockaddr_in sin;
+	struct pollfd fds[2];
+	uint8_t payload[4];
+	char line[64];
+
+	/* parse options */
+	while ((opt = getopt(argc, argv, "s:n:q")) != -1) {
+		switch (opt) {
+			case 's':
+				session = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				max_frames = atol(optarg);
+				break;
+			case 'q':
+				quiet = 1;
+				break;
+			default:
+				goto usage;
+		}
+	}
+
+	/* check arguments */
+	if (optind != argc - 2)
+		goto usage;
+
+	/* connect */
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(atoi(argv[optind + 1]));
+	if (inet_pton(AF_INET, argv[optind], &sin.sin_addr) != 1)
+		goto usage;
+
+	client.fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (client.fd < 0 || connect(client.fd, (struct sockaddr *) &sin, sizeof(sin))) {
+		perror("Can't connect");
+		return EXIT_FAILURE;
+	}
+	setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	/* attach to session */
+	chip8_proto_put32(payload, session);
+	if (client_send(&client, CHIP8_PROTO_HELLO, payload, 4))
+		return EXIT_FAILURE;
+
+	/* key events are read from stdin : "<key in hex> <0|1>" */
+	fds[0].fd = client.fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = STDIN_FILENO;
+	fds[1].events = POLLIN;
+
+	while (max_frames < 0 || (long) client.nr_frames < max_frames) {
+		if (poll(fds, fds[1].fd < 0 ? 1 : 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		/* server messages */
+		if (fds[0].revents) {
+			if (client_read(&client)) {
+				fprintf(stderr, "Connection closed\n");
+				break;
+			}
+
+			if (!quiet)
+				client_print(&client, 1);
+		}
+
+		/* key events */
+		if (fds[1].revents) {
+			if (!fgets(line, sizeof(line), stdin)) {
+				fds[1].fd = -1;
+				continue;
+			}
+
+			if (sscanf(line, "%x %u", &key, &pressed) == 2) {
+				payload[0] = key;
+				payload[1] = pressed;
+				client_send(&client, CHIP8_PROTO_KEY, payload, 2);
+			}
+		}
+	}
+
+	/* print final display and statistics */
+	client_print(&client, 0);
+	printf("%llu frames, %llu bytes received\n", (unsigned long long) client.nr_frames, (unsigned long long) client.nr_bytes);
+	close(client.fd);
+
+	/* connection lost before all requested frames were received */
+	if (max_frames >= 0 && (long) client.nr_frames < max_frames)
+		ret = EXIT_FAILURE;
+
+	return ret;
+usage:
+	fprintf(stderr, "Usage: %s [-s session] [-n frames] [-q] <host> <port>\n", argv[0]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+#define MAX_ROMS		64
+#define NR_PROFILES		3
+#define NR_TIMINGS		2
+#define PATH_SIZE		256
+#define PERF_NR_RUNS		5
+#define PERF_RUN_US		50000
+#define DEFAULT_THRESHOLD	30
+#define SEED			1
+#define CALIBRATION_TABLE_SIZE	4096
+#define CALIBRATION_NR_LOOPS	100000
+
+/*
+ * Quirk profiles checked against goldens.
+ */
+static const char *profiles[NR_PROFILES] = { "cosmac", "schip", "xochip" };
+
+/*
+ * Timing modes checked against goldens.
+ */
+static const char *timings[NR_TIMINGS] = { "fixed", "vip" };
+
+/*
+ * Corpus ROM.
+ */
+struct rom_t {
+	char		path[PATH_SIZE];				/* ROM path */
+	uint8_t *	data;						/* ROM content */
+	size_t		size;						/* ROM size */
+	uint32_t	nr_ticks;					/* ticks to run (fixed timing, same emulated time in VIP timing) */
+	uint64_t	golden[NR_PROFILES][NR_TIMINGS];		/* expected display hashes (0 = none) */
+	uint64_t	hash[NR_PROFILES][NR_TIMINGS];			/* display hashes */
+	int		error[NR_PROFILES][NR_TIMINGS];			/* 1 if chip8 stopped on an error */
+	double		baseline;					/* expected relative throughput (0 = none) */
+	uint64_t	ips;						/* instructions/s */
+	double		speed;						/* instructions per calibration loop */
+	uint8_t		hires[NR_PROFILES][NR_TIMINGS];		/* final display modes */
+	uint64_t	gfx[NR_PROFILES][NR_TIMINGS][CHIP8_GFX_NR_PLANES][CHIP8_GFX_HIRES_HEIGHT][CHIP8_GFX_ROW_WORDS];	/* final displays */
+};
+
+/*
+ * Runner.
+ */
+struct runner_t {
+	struct rom_t	roms[MAX_ROMS];					/* corpus */
+	int		nr_roms;					/* number of ROMs */
+	atomic_int	next_job;					/* next job ((rom * NR_PROFILES + profile) * NR_TIMINGS + timing) */
+};
+
+/*
+ * Get monotonic time in microseconds.
+ */
+static uint64_t clock_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Hash visible display (FNV-1a).
+ */
+static uint64_t display_hash(const struct chip8_t *chip8)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	int p, y, w, b;
+
+	hash = (hash ^ chip8->hires) * 0x100000001B3ULL;
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++)
+		for (y = 0; y < CHIP8_GFX_HEIGHT(chip8); y++)
+			for (w = 0; w < CHIP8_GFX_ROW_WORDS; w++)
+				for (b = 0; b < 64; b += 8)
+					hash = (hash ^ ((chip8_gfx_row(chip8, p, y)[w] >> b) & 0xFF)) * 0x100000001B3ULL;
+
+	return hash;
+}
+
+/*
+ * Print final display of a (ROM, profile, timing) run.
+ */
+static void display_print(const struct rom_t *rom, int p, int t)
+{
+	int x, y, width, height, val;
+
+	width = rom->hires[p][t] ? CHIP8_GFX_HIRES_WIDTH : CHIP8_GFX_LORES_WIDTH;
+	height = rom->hires[p][t] ? CHIP8_GFX_HIRES_HEIGHT : CHIP8_GFX_LORES_HEIGHT;
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			val = ((rom->gfx[p][t][0][y][x / 64] >> (63 - x % 64)) & 1) | (((rom->gfx[p][t][1][y][x / 64] >> (63 - x % 64)) & 1) << 1);
+			putchar(" #+*"[val]);
+		}
+		putchar('\n');
+	}
+}
+
+/*
+ * Load ROM and run it headless for its number of ticks (fixed timing),
+ * or for as many frames as these ticks last (VIP timing).
+ */
+static int rom_run(struct rom_t *rom, struct chip8_t *chip8, int quirks, int timing)
+{
+	uint32_t i, nr_frames;
+
+	chip8_reset(chip8);
+	chip8_seed(chip8, SEED);
+	chip8_set_timing(chip8, timing);
+	if (chip8_set_quirks(chip8, quirks) || chip8_load_rom_buffer(chip8, rom->data, rom->size))
+		return EXIT_FAILURE;
+
+	if (timing == CHIP8_TIMING_VIP) {
+		nr_frames = (uint64_t) rom->nr_ticks * CHIP8_TICK_FREQ_US / CHIP8_FRAME_FREQ_US;
+		for (i = 0; i < nr_frames; i++)
+			if (chip8_run_frame(chip8))
+				return EXIT_FAILURE;
+
+		return EXIT_SUCCESS;
+	}
+
+	for (i = 0; i < rom->nr_ticks; i++)
+		if (chip8_tick(chip8))
+			return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Worker thread : run (ROM, profile, timing) jobs.
+ */
+static void *runner_worker(void *arg)
+{
+	struct runner_t *runner = (struct runner_t *) arg;
+	struct chip8_t *chip8;
+	struct rom_t *rom;
+	int job, p, t;
+
+	/* memory for the largest profile : quirks only narrow addressable memory */
+	chip8 = chip8_create(NULL, CHIP8_PROFILE_XOCHIP);
+	if (!chip8)
+		return NULL;
+
+	while ((job = atomic_fetch_add(&runner->next_job, 1)) < runner->nr_roms * NR_PROFILES * NR_TIMINGS) {
+		rom = &runner->roms[job / (NR_PROFILES * NR_TIMINGS)];
+		p = job / NR_TIMINGS % NR_PROFILES;
+		t = job % NR_TIMINGS;
+
+		rom->error[p][t] = rom_run(rom, chip8, chip8_profile(profiles[p]), chip8_timing(timings[t]));
+		rom->hash[p][t] = display_hash(chip8);
+		rom->hires[p][t] = chip8->hires;
+		memcpy(rom->gfx[p][t], chip8_gfx_row(chip8, 0, 0), CHIP8_GFX_SIZE);
+	}
+
+	chip8_destroy(chip8);
+	return NULL;
+}
+
+/*
+ * Calibration run : table lookups and data dependent branches, similar in kind to instruction dispatch.
+ * Returns loops/s.
+ */
+static uint64_t calibration_run(void)
+{
+	static uint8_t table[CALIBRATION_TABLE_SIZE];
+	uint64_t start_us, elapsed_us, nr_loops = 0;
+	uint32_t x = SEED, acc = 0;
+	volatile uint32_t sink;
+	int i;
+
+	for (i = 0; i < CALIBRATION_TABLE_SIZE; i++)
+		table[i] = i * 37;
+
+	start_us = clock_us();
+	do {
+		for (i = 0; i < CALIBRATION_NR_LOOPS; i++) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			if (table[x % CALIBRATION_TABLE_SIZE] & 1)
+				acc += x;
+			else
+				table[acc % CALIBRATION_TABLE_SIZE]++;
+		}
+		nr_loops += CALIBRATION_NR_LOOPS;
+		elapsed_us = clock_us() - start_us;
+	} while (elapsed_us < PERF_RUN_US);
+
+	/* keep the loop */
+	sink = acc;
+	(void) sink;
+
+	return nr_loops * 1000000ULL / elapsed_us;
+}
+
+/*
+ * Measure instructions/s of a ROM (default profile, fixed timing, single thread) and its throughput relative
+ * to the calibration loop, so that baselines hold across machines.
+ * Best of PERF_NR_RUNS runs : noise only makes runs slower. ROM and calibration runs are
+ * interleaved so that both see the same machine load.
+ */
+static void rom_perf(struct rom_t *rom, struct chip8_t *chip8)
+{
+	uint64_t start_us, elapsed_us, nr_ticks, ips, lps, best_lps = 0;
+	int i;
+
+	rom->ips = 0;
+	for (i = 0; i < PERF_NR_RUNS; i++) {
+		lps = calibration_run();
+		if (lps > best_lps)
+			best_lps = lps;
+
+		nr_ticks = 0;
+		start_us = clock_us();
+		do {
+			rom_run(rom, chip8, CHIP8_PROFILE_DEFAULT, CHIP8_TIMING_FIXED);
+			nr_ticks += rom->nr_ticks;
+			elapsed_us = clock_us() - start_us;
+		} while (elapsed_us < PERF_RUN_US);
+
+		ips = nr_ticks * 1000000ULL / elapsed_us;
+		if (ips > rom->ips)
+			rom->ips = ips;
+	}
+
+	rom->speed = (double) rom->ips / best_lps;
+}
+
+/*
+ * Load corpus : "<rom path> <ticks>" per line.
+ */
+static int corpus_load(struct runner_t *runner, const char *path)
+{
+	char line[PATH_SIZE + 32];
+	FILE *fp, *rom_fp;
+	struct rom_t *rom;
+	long size;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return EXIT_FAILURE;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (runner->nr_roms >= MAX_ROMS)
+			break;
+
+		rom = &runner->roms[runner->nr_roms];
+		if (sscanf(line, "%255s %u", rom->path, &rom->nr_ticks) != 2)
+			continue;
+
+		/* load ROM content */
+		rom_fp = fopen(rom->path, "rb");
+		if (!rom_fp) {
+			fprintf(stderr, "Can't load ROM \"%s\"\n", rom->path);
+			fclose(fp);
+			return EXIT_FAILURE;
+		}
+
+		fseek(rom_fp, 0, SEEK_END);
+		size = ftell(rom_fp);
+		fseek(rom_fp, 0, SEEK_SET);
+
+		rom->data = (uint8_t *) malloc(size > 0 ? size : 1);
+		rom->size = rom->data ? fread(rom->data, 1, size, rom_fp) : 0;
+		fclose(rom_fp);
+
+		runner->nr_roms++;
+	}
+
+	fclose(fp);
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Find a corpus ROM.
+ */
+static struct rom_t *corpus_find(struct runner_t *runner, const char *path)
+{
+	int i;
+
+	for (i = 0; i < runner->nr_roms; i++)
+		if (strcmp(runner->roms[i].path, path) == 0)
+			return &runner->roms[i];
+
+	return NULL;
+}
+
+/*
+ * Load goldens ("<rom path> <profile> <timing> <hash>") and baselines ("<rom path> <instructions per calibration loop>").
+ */
+static void expected_load(struct runner_t *runner, const char *golden_path, const char *baseline_path)
+{
+	char line[PATH_SIZE + 64], path[PATH_SIZE], profile[16], timing[16];
+	unsigned long long val;
+	struct rom_t *rom;
+	double speed;
+	FILE *fp;
+	int p, t;
+
+	fp = fopen(golden_path, "r");
+	while (fp && fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%255s %15s %15s %llx", path, profile, timing, &val) != 4 || !(rom = corpus_find(runner, path)))
+			continue;
+
+		for (p = 0; p < NR_PROFILES; p++)
+			for (t = 0; t < NR_TIMINGS; t++)
+				if (strcmp(profile, profiles[p]) == 0 && strcmp(timing, timings[t]) == 0)
+					rom->golden[p][t] = val;
+	}
+	if (fp)
+		fclose(fp);
+
+	fp = baseline_path ? fopen(baseline_path, "r") : NULL;
+	while (fp && fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%255s %lf", path, &speed) == 2 && (rom = corpus_find(runner, path)))
+			rom->baseline = speed;
+	}
+	if (fp)
+		fclose(fp);
+}
+
+/*
+ * Write goldens and baselines (if measured) from this run.
+ */
+static int expected_save(struct runner_t *runner, const char *golden_path, const char *baseline_path)
+{
+	FILE *golden_fp, *baseline_fp = NULL;
+	int i, p, t;
+
+	golden_fp = fopen(golden_path, "w");
+	if (baseline_path)
+		baseline_fp = fopen(baseline_path, "w");
+	if (!golden_fp || (baseline_path && !baseline_fp)) {
+		if (golden_fp)
+			fclose(golden_fp);
+		if (baseline_fp)
+			fclose(baseline_fp);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < runner->nr_roms; i++) {
+		for (p = 0; p < NR_PROFILES; p++)
+			for (t = 0; t < NR_TIMINGS; t++)
+				if (!runner->roms[i].error[p][t])
+					fprintf(golden_fp, "%s %s %s %016llx\n", runner->roms[i].path, profiles[p], timings[t],
+						(unsigned long long) runner->roms[i].hash[p][t]);
+
+		if (baseline_fp)
+			fprintf(baseline_fp, "%s %.2f\n", runner->roms[i].path, runner->roms[i].speed);
+	}
+
+	fclose(golden_fp);
+	if (baseline_fp)
+		fclose(baseline_fp);
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Run a ROM corpus under every quirk profile and timing mode in parallel, check final displays against goldens,
+ * then (with a baseline) measure throughput of each ROM relative to a calibration loop.
+ */
+int main(int argc, char **argv)
+{
+	int opt, nr_threads = sysconf(_SC_NPROCESSORS_ONLN), threshold = DEFAULT_THRESHOLD, update = 0, dump = 0;
+	int i, p, t, nr_failures = 0;
+	const char *baseline_path = NULL;
+	static struct runner_t runner;
+	struct chip8_t *chip8;
+	pthread_t *threads;
+	struct rom_t *rom;
+	double drop;
+
+	/* parse options */
+	while ((opt = getopt(argc, argv, "b:j:t:ud")) != -1) {
+		switch (opt) {
+			case 'b':
+				baseline_path = optarg;
+				break;
+			case 'j':
+				nr_threads = atoi(optarg);
+				break;
+			case 't':
+				threshold = atoi(optarg);
+				break;
+			case 'u':
+				update = 1;
+				break;
+			case 'd':
+				dump = 1;
+				break;
+			default:
+				goto usage;
+		}
+	}
+
+	/* check arguments */
+	if (optind != argc - 2 || nr_threads < 1)
+		goto usage;
+
+	if (corpus_load(&runner, argv[optind])) {
+		fprintf(stderr, "Can't load corpus \"%s\"\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+	expected_load(&runner, argv[optind + 1], baseline_path);
+
+	/* conformance : every (ROM, profile, timing) run in parallel */
+	threads = (pthread_t *) malloc(nr_threads * sizeof(pthread_t));
+	chip8 = chip8_create(NULL, CHIP8_PROFILE_DEFAULT);
+	if (!threads || !chip8)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_create(&threads[i], NULL, runner_worker, &runner);
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < runner.nr_roms; i++) {
+		rom = &runner.roms[i];
+
+		for (p = 0; p < NR_PROFILES; p++) {
+			for (t = 0; t < NR_TIMINGS; t++) {
+				if (rom->error[p][t]) {
+					printf("FAIL %s %s %s : chip8 error\n", rom->path, profiles[p], timings[t]);
+					nr_failures++;
+				} else if (!update && rom->hash[p][t] != rom->golden[p][t]) {
+					printf("FAIL %s %s %s : display %016llx, expected %016llx\n", rom->path, profiles[p], timings[t],
+					       (unsigned long long) rom->hash[p][t], (unsigned long long) rom->golden[p][t]);
+					nr_failures++;
+				} else {
+					printf("ok   %s %s %s %016llx\n", rom->path, profiles[p], timings[t], (unsigned long long) rom->hash[p][t]);
+				}
+
+				if (dump)
+					display_print(rom, p, t);
+			}
+		}
+	}
+
+	/* throughput : one ROM at a time so that runs don't disturb each other */
+	for (i = 0; baseline_path && i < runner.nr_roms; i++) {
+		rom = &runner.roms[i];
+		rom_perf(rom, chip8);
+
+		if (!rom->baseline || update) {
+			printf("perf %s : %.1f M instructions/s, %.2f per loop\n", rom->path, rom->ips / 1e6, rom->speed);
+			continue;
+		}
+
+		drop = 100.0 * (rom->baseline - rom->speed) / rom->baseline;
+		if (threshold > 0 && drop > threshold) {
+			printf("FAIL %s : %.1f M instructions/s, %.2f per loop, baseline %.2f (-%.1f %% > %d %%)\n",
+			       rom->path, rom->ips / 1e6, rom->speed, rom->baseline, drop, threshold);
+			nr_failures++;
+		} else {
+			printf("perf %s : %.1f M instructions/s, %.2f per loop, baseline %.2f (%+.1f %%)\n",
+			       rom->path, rom->ips / 1e6, rom->speed, rom->baseline, -drop);
+		}
+	}
+	chip8_destroy(chip8);
+
+	/* update goldens and baselines */
+	if (update && expected_save(&runner, argv[optind + 1], baseline_path)) {
+		fprintf(stderr, "Can't write goldens/baselines\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%d failure(s)\n", nr_failures);
+	return nr_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+usage:
+	fprintf(stderr, "Usage: %s [-b baseline] [-j threads] [-t threshold_percent] [-u] [-d] <corpus> <golden>\n", argv[0]);
+	return EXIT_FAILURE;
+}
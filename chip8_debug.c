@@ -0,0 +1,517 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "chip8_debug.h"
+
+static const char debug_hex[] = "0123456789abcdef";
+
+/*
+ * Send a packet ($data#checksum).
+ */
+static void debug_send(struct chip8_debug_t *dbg, const char *data)
+{
+	char buf[CHIP8_DEBUG_BUF_SIZE + 4];
+	uint8_t checksum = 0;
+	size_t len = 0;
+
+	buf[len++] = '$';
+	for (; *data && len < CHIP8_DEBUG_BUF_SIZE; data++) {
+		checksum += (uint8_t) *data;
+		buf[len++] = *data;
+	}
+
+	buf[len++] = '#';
+	buf[len++] = debug_hex[checksum >> 4];
+	buf[len++] = debug_hex[checksum & 0x0F];
+
+	if (send(dbg->fd, buf, len, MSG_NOSIGNAL) != (ssize_t) len)
+		fprintf(stderr, "Debugger : can't send packet\n");
+}
+
+/*
+ * Send stop reply.
+ */
+static void debug_send_stop(struct chip8_debug_t *dbg)
+{
+	char buf[32];
+
+	switch (dbg->stop) {
+		case CHIP8_DEBUG_WATCHPOINT:
+			snprintf(buf, sizeof(buf), "T05watch:%x;", dbg->watch_addr);
+			break;
+		case CHIP8_DEBUG_INTERRUPT:
+			strcpy(buf, "S02");
+			break;
+		case CHIP8_DEBUG_ERROR:
+			strcpy(buf, "S04");
+			break;
+		case CHIP8_DEBUG_RUNNING:
+			strcpy(buf, "S00");
+			break;
+		default:
+			strcpy(buf, "S05");
+			break;
+	}
+
+	debug_send(dbg, buf);
+}
+
+/*
+ * Stop execution and notify debugger.
+ */
+static void debug_stop(struct chip8_debug_t *dbg, enum chip8_debug_stop_t reason)
+{
+	dbg->stop = reason;
+	dbg->step = 0;
+
+	if (CHIP8_DEBUG_ATTACHED(dbg))
+		debug_send_stop(dbg);
+}
+
+/*
+ * Detach debugger : clear breakpoints and resume execution.
+ */
+static void debug_detach(struct chip8_debug_t *dbg)
+{
+	if (dbg->fd >= 0)
+		close(dbg->fd);
+
+	memset(dbg->breakpoints, 0, sizeof(dbg->breakpoints));
+	memset(dbg->watchpoints, 0, sizeof(dbg->watchpoints));
+	dbg->nr_conditions = 0;
+	dbg->stop = CHIP8_DEBUG_RUNNING;
+	dbg->step = 0;
+	dbg->resume = 0;
+	dbg->fd = -1;
+	dbg->in_len = 0;
+}
+
+/*
+ * Evaluate a register condition.
+ */
+static int debug_cond_eval(const struct chip8_debug_cond_t *cond, const struct chip8_t *chip8)
+{
+	uint16_t val = cond->reg == CHIP8_DEBUG_REG_I ? chip8->I : chip8->V[cond->reg];
+
+	switch (cond->op) {
+		case CHIP8_DEBUG_EQ:
+			return val == cond->val;
+		case CHIP8_DEBUG_NE:
+			return val != cond->val;
+		case CHIP8_DEBUG_LT:
+			return val < cond->val;
+		case CHIP8_DEBUG_GT:
+			return val > cond->val;
+		case CHIP8_DEBUG_LE:
+			return val <= cond->val;
+		default:
+			return val >= cond->val;
+	}
+}
+
+/*
+ * Decode an hex string.
+ */
+static int debug_unhex(const char *hex, size_t len, uint8_t *out)
+{
+	unsigned int byte;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (sscanf(hex + 2 * i, "%2x", &byte) != 1)
+			return EXIT_FAILURE;
+
+		out[i] = byte;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Handle a monitor command (qRcmd).
+ */
+static void debug_monitor(struct chip8_debug_t *dbg, const char *hex)
+{
+	char cmd[CHIP8_DEBUG_BUF_SIZE / 2];
+	size_t len = strlen(hex) / 2;
+
+	if (len >= sizeof(cmd) || debug_unhex(hex, len, (uint8_t *) cmd)) {
+		debug_send(dbg, "E01");
+		return;
+	}
+	cmd[len] = 0;
+
+	if (strcmp(cmd, "cond clear") == 0) {
+		dbg->nr_conditions = 0;
+		debug_send(dbg, "OK");
+	} else if (strncmp(cmd, "cond ", 5) == 0 && chip8_debug_add_condition(dbg, cmd + 5) == EXIT_SUCCESS) {
+		debug_send(dbg, "OK");
+	} else {
+		debug_send(dbg, "E01");
+	}
+}
+
+/*
+ * Handle a packet.
+ */
+static void debug_packet(struct chip8_debug_t *dbg, struct chip8_t *chip8, char *data)
+{
+	char buf[CHIP8_DEBUG_BUF_SIZE];
+	unsigned int type, addr, len, i;
+	uint8_t bytes[CHIP8_DEBUG_MAX_READ];
+	char *p;
+
+	switch (data[0]) {
+		case '?':
+			debug_send_stop(dbg);
+			break;
+		case 'g':
+			for (i = 0, p = buf; i < CHIP8_NR_REGISTERS; i++)
+				p += sprintf(p, "%02x", chip8->V[i]);
+			sprintf(p, "%04x%04x%02x%02x%02x", chip8->I, chip8->pc, chip8->sp & 0xFF, chip8->delay_timer, chip8->sound_timer);
+			debug_send(dbg, buf);
+			break;
+		case 'm':
+			if (sscanf(data + 1, "%x,%x", &addr, &len) != 2 || len > CHIP8_DEBUG_MAX_READ) {
+				debug_send(dbg, "E01");
+				break;
+			}
+
+			for (i = 0, p = buf; i < len; i++)
+				p += sprintf(p, "%02x", *chip8_mem(chip8, addr + i));
+			*p = 0;
+			debug_send(dbg, buf);
+			break;
+		case 'M':
+			p = strchr(data, ':');
+			if (sscanf(data + 1, "%x,%x", &addr, &len) != 2 || len > CHIP8_DEBUG_MAX_READ || !p
+			    || strlen(p + 1) < 2 * len || debug_unhex(p + 1, len, bytes)) {
+				debug_send(dbg, "E01");
+				break;
+			}
+
+			for (i = 0; i < len; i++) {
+				*chip8_mem(chip8, addr + i) = bytes[i];
+				CHIP8_MEM_DIRTY(chip8, CHIP8_ADDR(chip8, addr + i));
+			}
+			debug_send(dbg, "OK");
+			break;
+		case 'Z':
+		case 'z':
+			if (sscanf(data + 1, "%x,%x,%x", &type, &addr, &len) != 3 || (type != 0 && type != 2)) {
+				debug_send(dbg, "");
+				break;
+			}
+
+			if (type == 0)
+				chip8_debug_set_breakpoint(dbg, addr, data[0] == 'Z');
+			else
+				chip8_debug_set_watchpoint(dbg, addr, len, data[0] == 'Z');
+			debug_send(dbg, "OK");
+			break;
+		case 's':
+		case 'c':
+			dbg->step = data[0] == 's';
+			dbg->resume = 1;
+			dbg->stop = CHIP8_DEBUG_RUNNING;
+			break;
+		case 'q':
+			if (strncmp(data, "qRcmd,", 6) == 0)
+				debug_monitor(dbg, data + 6);
+			else
+				debug_send(dbg, "");
+			break;
+		case 'D':
+			debug_send(dbg, "OK");
+			debug_detach(dbg);
+			break;
+		case 'k':
+			debug_detach(dbg);
+			break;
+		default:
+			debug_send(dbg, "");
+			break;
+	}
+}
+
+/*
+ * Parse received data.
+ */
+static void debug_parse(struct chip8_debug_t *dbg, struct chip8_t *chip8)
+{
+	size_t pos = 0, end;
+	unsigned int checksum;
+	uint8_t sum;
+	char *hash;
+
+	while (pos < dbg->in_len && CHIP8_DEBUG_ATTACHED(dbg)) {
+		/* interrupt */
+		if (dbg->in[pos] == 0x03) {
+			if (dbg->stop == CHIP8_DEBUG_RUNNING)
+				debug_stop(dbg, CHIP8_DEBUG_INTERRUPT);
+			pos++;
+			continue;
+		}
+
+		/* acks and garbage */
+		if (dbg->in[pos] != '$') {
+			pos++;
+			continue;
+		}
+
+		/* wait for complete packet */
+		hash = memchr(dbg->in + pos, '#', dbg->in_len - pos);
+		if (!hash || (size_t) (hash - dbg->in) + 3 > dbg->in_len)
+			break;
+
+		end = hash - dbg->in;
+		for (sum = 0, checksum = pos + 1; checksum < end; checksum++)
+			sum += (uint8_t) dbg->in[checksum];
+
+		if (sscanf(hash + 1, "%2x", &checksum) != 1 || checksum != sum) {
+			send(dbg->fd, "-", 1, MSG_NOSIGNAL);
+		} else {
+			send(dbg->fd, "+", 1, MSG_NOSIGNAL);
+			*hash = 0;
+			debug_packet(dbg, chip8, dbg->in + pos + 1);
+		}
+
+		pos = end + 3;
+	}
+
+	/* detached while parsing */
+	if (!CHIP8_DEBUG_ATTACHED(dbg))
+		return;
+
+	/* keep partial packet (drop it if it can't fit) */
+	if (pos >= dbg->in_len || dbg->in_len - pos == sizeof(dbg->in)) {
+		dbg->in_len = 0;
+		return;
+	}
+
+	memmove(dbg->in, dbg->in + pos, dbg->in_len - pos);
+	dbg->in_len -= pos;
+}
+
+/*
+ * Listen for a debugger on a local port (non blocking).
+ */
+int chip8_debug_listen(struct chip8_debug_t *dbg, uint16_t port)
+{
+	struct sockaddr_in sin;
+	int one = 1;
+
+	memset(dbg, 0, sizeof(struct chip8_debug_t));
+	dbg->fd = -1;
+
+	dbg->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (dbg->listen_fd < 0)
+		return EXIT_FAILURE;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	setsockopt(dbg->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(dbg->listen_fd, (struct sockaddr *) &sin, sizeof(sin)) || listen(dbg->listen_fd, 1)) {
+		close(dbg->listen_fd);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Accept a debugger and handle its requests (non blocking, call once per frame).
+ * Attaching stops execution until the debugger continues.
+ */
+void chip8_debug_poll(struct chip8_debug_t *dbg, struct chip8_t *chip8)
+{
+	ssize_t n;
+	int fd;
+
+	/* attach */
+	if (!CHIP8_DEBUG_ATTACHED(dbg)) {
+		fd = accept4(dbg->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		dbg->fd = fd;
+		dbg->stop = CHIP8_DEBUG_INTERRUPT;
+	}
+
+	/* read requests */
+	for (;;) {
+		n = recv(dbg->fd, dbg->in + dbg->in_len, sizeof(dbg->in) - dbg->in_len, 0);
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		if (n <= 0) {
+			debug_detach(dbg);
+			break;
+		}
+
+		dbg->in_len += n;
+		debug_parse(dbg, chip8);
+		if (!CHIP8_DEBUG_ATTACHED(dbg))
+			break;
+	}
+}
+
+/*
+ * Instrumented chip8_tick() : check breakpoints before the instruction, watchpoints,
+ * conditions and single step after. Does nothing while stopped.
+ */
+int chip8_debug_tick(struct chip8_debug_t *dbg, struct chip8_t *chip8)
+{
+	uint16_t opcode, pc = CHIP8_ADDR(chip8, chip8->pc), start = chip8->I, len = 0;
+	uint32_t before = 0;
+	int i;
+
+	if (dbg->stop != CHIP8_DEBUG_RUNNING)
+		return EXIT_SUCCESS;
+
+	/* display wait : idle tick, no instruction to check */
+	if (chip8->display_wait)
+		return chip8_tick(chip8);
+
+	/* PC breakpoint (ignored on the instruction execution resumes from) */
+	if (!dbg->resume && CHIP8_DEBUG_TEST(dbg->breakpoints, pc)) {
+		debug_stop(dbg, CHIP8_DEBUG_BREAKPOINT);
+		return EXIT_SUCCESS;
+	}
+	dbg->resume = 0;
+
+	/* memory written by the instruction (FX33, FX55, 5XY2) */
+	opcode = (*chip8_mem(chip8, pc) << 8) | *chip8_mem(chip8, pc + 1);
+	if ((opcode & 0xF0FF) == 0xF033)
+		len = 3;
+	else if ((opcode & 0xF0FF) == 0xF055)
+		len = ((opcode & 0x0F00) >> 8) + 1;
+	else if ((opcode & 0xF00F) == 0x5002)
+		len = abs(((opcode & 0x0F00) >> 8) - ((opcode & 0x00F0) >> 4)) + 1;
+
+	/* conditions are edge triggered */
+	for (i = 0; i < dbg->nr_conditions; i++)
+		before |= debug_cond_eval(&dbg->conditions[i], chip8) << i;
+
+	/* execute (errors stop the debugged program instead of the host) */
+	if (chip8_tick(chip8)) {
+		debug_stop(dbg, CHIP8_DEBUG_ERROR);
+		return EXIT_SUCCESS;
+	}
+
+	for (i = 0; i < len; i++) {
+		if (CHIP8_DEBUG_TEST(dbg->watchpoints, CHIP8_ADDR(chip8, start + i))) {
+			dbg->watch_addr = CHIP8_ADDR(chip8, start + i);
+			debug_stop(dbg, CHIP8_DEBUG_WATCHPOINT);
+			return EXIT_SUCCESS;
+		}
+	}
+
+	for (i = 0; i < dbg->nr_conditions; i++) {
+		if (!((before >> i) & 1) && debug_cond_eval(&dbg->conditions[i], chip8)) {
+			debug_stop(dbg, CHIP8_DEBUG_CONDITION);
+			return EXIT_SUCCESS;
+		}
+	}
+
+	if (dbg->step)
+		debug_stop(dbg, CHIP8_DEBUG_STEP);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Detach debugger and stop listening.
+ */
+void chip8_debug_close(struct chip8_debug_t *dbg)
+{
+	debug_detach(dbg);
+	close(dbg->listen_fd);
+}
+
+/*
+ * Set or clear a PC breakpoint.
+ */
+void chip8_debug_set_breakpoint(struct chip8_debug_t *dbg, uint16_t addr, int on)
+{
+	addr &= CHIP8_MEMORY_MAX_SIZE - 1;
+
+	if (on)
+		dbg->breakpoints[addr / 64] |= 1ULL << (addr % 64);
+	else
+		dbg->breakpoints[addr / 64] &= ~(1ULL << (addr % 64));
+}
+
+/*
+ * Set or clear a write watchpoint on len bytes (overlapping watchpoints share addresses).
+ */
+void chip8_debug_set_watchpoint(struct chip8_debug_t *dbg, uint16_t addr, uint16_t len, int on)
+{
+	uint16_t a;
+	int i;
+
+	for (i = 0; i < (len ? len : 1); i++) {
+		a = (addr + i) & (CHIP8_MEMORY_MAX_SIZE - 1);
+
+		if (on)
+			dbg->watchpoints[a / 64] |= 1ULL << (a % 64);
+		else
+			dbg->watchpoints[a / 64] &= ~(1ULL << (a % 64));
+	}
+}
+
+/*
+ * Add a register condition : "<Vx|I> <op> <val>".
+ */
+int chip8_debug_add_condition(struct chip8_debug_t *dbg, const char *expr)
+{
+	static const char *ops[] = { "==", "!=", "<", ">", "<=", ">=" };
+	struct chip8_debug_cond_t cond;
+	char reg[4], op[4];
+	unsigned int i;
+	long val;
+	char *end;
+	int n;
+
+	if (dbg->nr_conditions >= CHIP8_DEBUG_MAX_CONDITIONS)
+		return EXIT_FAILURE;
+
+	if (sscanf(expr, "%3s %3s %n", reg, op, &n) != 2)
+		return EXIT_FAILURE;
+
+	/* register */
+	if ((reg[0] == 'I' || reg[0] == 'i') && !reg[1])
+		cond.reg = CHIP8_DEBUG_REG_I;
+	else if ((reg[0] == 'V' || reg[0] == 'v') && reg[1] && !reg[2] && strchr(debug_hex, reg[1] | 0x20))
+		cond.reg = strchr(debug_hex, reg[1] | 0x20) - debug_hex;
+	else
+		return EXIT_FAILURE;
+
+	/* operator */
+	for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+		if (strcmp(op, ops[i]) == 0)
+			break;
+	if (i == sizeof(ops) / sizeof(ops[0]))
+		return EXIT_FAILURE;
+	cond.op = i;
+
+	/* value */
+	val = strtol(expr + n, &end, 0);
+	if (end == expr + n || val < 0 || val > 0xFFFF)
+		return EXIT_FAILURE;
+	cond.val = val;
+
+	dbg->conditions[dbg->nr_conditions++] = cond;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#ifndef _CHIP8_DEBUG_H_
+#define _CHIP8_DEBUG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+/*
+ * Debugger, driven by a GDB remote serial protocol subset over a local TCP socket.
+ *
+ * Packets are $data#checksum (acknowledged with +). Supported requests :
+ *   ?                  last stop reason
+ *   g                  registers : V0..VF (1 byte each), I (2), PC (2), SP (1), DT (1), ST (1), big endian
+ *   m addr,len         read memory
+ *   M addr,len:data    write memory
+ *   Z0,addr,kind       set PC breakpoint (z0 clears it)
+ *   Z2,addr,len        set write watchpoint (z2 clears it)
+ *   s / c              single step / continue
+ *   0x03               interrupt
+ *   qRcmd,hex          monitor command : "cond <Vx|I> <op> <val>" (op is == != < > <= >=) or "cond clear"
+ *   D                  detach (clears breakpoints and resumes)
+ *
+ * Stop replies are S05 (breakpoint, step or condition), T05watch:addr; (watchpoint),
+ * S02 (interrupt) and S04 (chip8 error).
+ *
+ * The host runs chip8_debug_tick() instead of chip8_tick() only while a debugger is attached,
+ * so chip8_tick() itself carries no debugger check.
+ */
+#define CHIP8_DEBUG_BITMAP_SIZE		(CHIP8_MEMORY_MAX_SIZE / 64)
+#define CHIP8_DEBUG_MAX_CONDITIONS	16
+#define CHIP8_DEBUG_BUF_SIZE		1024
+#define CHIP8_DEBUG_MAX_READ		256
+#define CHIP8_DEBUG_REG_I		CHIP8_NR_REGISTERS	/* condition on I */
+
+/* 1 if a debugger is connected (host must then use chip8_debug_tick()) */
+#define CHIP8_DEBUG_ATTACHED(dbg)	((dbg)->fd >= 0)
+
+/* test an address in a bitmap */
+#define CHIP8_DEBUG_TEST(bitmap, addr)	(((bitmap)[(addr) / 64] >> ((addr) % 64)) & 1)
+
+/*
+ * Stop reason.
+ */
+enum chip8_debug_stop_t {
+	CHIP8_DEBUG_RUNNING,						/* not stopped */
+	CHIP8_DEBUG_BREAKPOINT,						/* PC breakpoint hit */
+	CHIP8_DEBUG_WATCHPOINT,						/* watched memory written */
+	CHIP8_DEBUG_CONDITION,						/* register condition became true */
+	CHIP8_DEBUG_STEP,						/* single step done */
+	CHIP8_DEBUG_INTERRUPT,						/* interrupted by debugger */
+	CHIP8_DEBUG_ERROR,						/* chip8 error (unknown opcode, stack) */
+};
+
+/*
+ * Condition operator.
+ */
+enum chip8_debug_op_t {
+	CHIP8_DEBUG_EQ,
+	CHIP8_DEBUG_NE,
+	CHIP8_DEBUG_LT,
+	CHIP8_DEBUG_GT,
+	CHIP8_DEBUG_LE,
+	CHIP8_DEBUG_GE,
+};
+
+/*
+ * Register condition (stops when it becomes true).
+ */
+struct chip8_debug_cond_t {
+	uint8_t			reg;					/* register (CHIP8_DEBUG_REG_I = I) */
+	uint8_t			op;					/* operator */
+	uint16_t		val;					/* value */
+};
+
+/*
+ * Debugger.
+ */
+struct chip8_debug_t {
+	uint64_t		breakpoints[CHIP8_DEBUG_BITMAP_SIZE];		/* PC breakpoints bitmap */
+	uint64_t		watchpoints[CHIP8_DEBUG_BITMAP_SIZE];		/* write watchpoints bitmap */
+	struct chip8_debug_cond_t conditions[CHIP8_DEBUG_MAX_CONDITIONS];	/* register conditions */
+	int			nr_conditions;					/* number of conditions */
+	enum chip8_debug_stop_t	stop;						/* stop reason (CHIP8_DEBUG_RUNNING = running) */
+	uint16_t		watch_addr;					/* written address of last watchpoint stop */
+	int			step;						/* 1 if stepping */
+	int			resume;						/* 1 to ignore breakpoint on first resumed instruction */
+	int			listen_fd;					/* listening socket */
+	int			fd;						/* debugger connection (-1 = detached) */
+	char			in[CHIP8_DEBUG_BUF_SIZE];			/* input buffer */
+	size_t			in_len;						/* input buffer length */
+};
+
+int chip8_debug_listen(struct chip8_debug_t *dbg, uint16_t port);
+void chip8_debug_poll(struct chip8_debug_t *dbg, struct chip8_t *chip8);
+int chip8_debug_tick(struct chip8_debug_t *dbg, struct chip8_t *chip8);
+void chip8_debug_close(struct chip8_debug_t *dbg);
+
+void chip8_debug_set_breakpoint(struct chip8_debug_t *dbg, uint16_t addr, int on);
+void chip8_debug_set_watchpoint(struct chip8_debug_t *dbg, uint16_t addr, uint16_t len, int on);
+int chip8_debug_add_condition(struct chip8_debug_t *dbg, const char *expr);
+
+#endif
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "chip8_debug.h"
+
+#define NR_REG_BYTES		(CHIP8_NR_REGISTERS + 7)
+
+static volatile sig_atomic_t interrupted = 0;
+
+/*
+ * SIGINT handler : interrupt debugged program.
+ */
+static void interrupt_cb(int sig)
+{
+	(void) sig;
+	interrupted = 1;
+}
+
+/*
+ * Send a packet.
+ */
+static int debugger_send(int fd, const char *data)
+{
+	char buf[CHIP8_DEBUG_BUF_SIZE + 4];
+	uint8_t checksum = 0;
+	size_t i;
+	int len;
+
+	for (i = 0; data[i]; i++)
+		checksum += (uint8_t) data[i];
+
+	len = snprintf(buf, sizeof(buf), "$%s#%02x", data, checksum);
+	return send(fd, buf, len, 0) == len ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Receive a packet (acks are skipped). SIGINT sends an interrupt while waiting.
+ */
+static int debugger_recv(int fd, char *data, size_t size)
+{
+	size_t len = 0;
+	int in_packet = 0;
+	ssize_t n;
+	char c;
+
+	for (;;) {
+		n = recv(fd, &c, 1, 0);
+		if (n < 0 && errno == EINTR) {
+			if (interrupted) {
+				interrupted = 0;
+				send(fd, "\003", 1, 0);
+			}
+			continue;
+		}
+
+		if (n <= 0)
+			return EXIT_FAILURE;
+
+		if (c == '$') {
+			in_packet = 1;
+			len = 0;
+		} else if (in_packet && c == '#') {
+			/* skip checksum */
+			if (recv(fd, &c, 1, MSG_WAITALL) != 1 || recv(fd, &c, 1, MSG_WAITALL) != 1)
+				return EXIT_FAILURE;
+
+			data[len] = 0;
+			send(fd, "+", 1, 0);
+			return EXIT_SUCCESS;
+		} else if (in_packet && len < size - 1) {
+			data[len++] = c;
+		}
+	}
+}
+
+/*
+ * Send a request and receive its reply.
+ */
+static int debugger_request(int fd, const char *req, char *reply, size_t size)
+{
+	if (debugger_send(fd, req))
+		return EXIT_FAILURE;
+
+	return debugger_recv(fd, reply, size);
+}
+
+/*
+ * Print registers.
+ */
+static int debugger_regs(int fd, int verbose)
+{
+	char reply[CHIP8_DEBUG_BUF_SIZE], mem[8];
+	unsigned int regs[NR_REG_BYTES], i;
+
+	if (debugger_request(fd, "g", reply, sizeof(reply)) || strlen(reply) != 2 * NR_REG_BYTES)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < NR_REG_BYTES; i++)
+		sscanf(reply + 2 * i, "%2x", &regs[i]);
+
+	/* current instruction */
+	snprintf(mem, sizeof(mem), "m%x,2", (regs[18] << 8) | regs[19]);
+	if (debugger_request(fd, mem, reply, sizeof(reply)))
+		return EXIT_FAILURE;
+
+	printf("pc %03x : %s", (regs[18] << 8) | regs[19], reply);
+	if (verbose) {
+		printf("   I %03x sp %u dt %02x st %02x\n", (regs[16] << 8) | regs[17], regs[20], regs[21], regs[22]);
+		for (i = 0; i < CHIP8_NR_REGISTERS; i++)
+			printf("V%X=%02x%c", i, regs[i], i == CHIP8_NR_REGISTERS - 1 ? '\n' : ' ');
+	} else {
+		putchar('\n');
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Wait for a stop reply and print it.
+ */
+static int debugger_wait_stop(int fd)
+{
+	char reply[CHIP8_DEBUG_BUF_SIZE];
+
+	if (debugger_recv(fd, reply, sizeof(reply)))
+		return EXIT_FAILURE;
+
+	if (strncmp(reply, "T05watch:", 9) == 0)
+		printf("watchpoint %.*s written, ", (int) strcspn(reply + 9, ";"), reply + 9);
+	else if (strcmp(reply, "S02") == 0)
+		printf("interrupted, ");
+	else if (strcmp(reply, "S04") == 0)
+		printf("chip8 error, ");
+
+	return debugger_regs(fd, 0);
+}
+
+/*
+ * Send a monitor command.
+ */
+static int debugger_monitor(int fd, const char *cmd, char *reply, size_t size)
+{
+	char req[CHIP8_DEBUG_BUF_SIZE];
+	size_t len;
+
+	len = snprintf(req, sizeof(req), "qRcmd,");
+	for (; *cmd && len + 3 < sizeof(req); cmd++)
+		len += snprintf(req + len, sizeof(req) - len, "%02x", (uint8_t) *cmd);
+
+	return debugger_request(fd, req, reply, size);
+}
+
+/*
+ * Print memory.
+ */
+static void debugger_dump(const char *hex, unsigned int addr)
+{
+	size_t i, len = strlen(hex) / 2;
+
+	for (i = 0; i < len; i++) {
+		if (i % 16 == 0)
+			printf("%s%04x :", i ? "\n" : "", (unsigned int) (addr + i));
+		printf(" %.2s", hex + 2 * i);
+	}
+
+	putchar('\n');
+}
+
+/*
+ * Command line debugger.
+ */
+int main(int argc, char **argv)
+{
+	char line[256], cmd[16], arg[sizeof(line)], req[sizeof(cmd) + sizeof(arg)], reply[CHIP8_DEBUG_BUF_SIZE];
+	unsigned int addr, len, i;
+	struct sockaddr_in sin;
+	struct sigaction sa;
+	int fd, n, c;
+
+	/* check arguments */
+	if (argc != 3)
+		goto usage;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(atoi(argv[2]));
+	if (inet_pton(AF_INET, argv[1], &sin.sin_addr) != 1)
+		goto usage;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *) &sin, sizeof(sin))) {
+		perror("Can't connect");
+		return EXIT_FAILURE;
+	}
+
+	/* SIGINT interrupts a running program (no restart : recv() must return) */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = interrupt_cb;
+	sigaction(SIGINT, &sa, NULL);
+
+	/* program is stopped on attach */
+	if (debugger_request(fd, "?", reply, sizeof(reply)) || debugger_regs(fd, 0))
+		goto err;
+
+	for (;;) {
+		printf("(chip8) ");
+		fflush(stdout);
+
+		if (!fgets(line, sizeof(line), stdin))
+			break;
+
+		/* reject (and skip) lines that don't fit instead of running a truncated command */
+		if (!strchr(line, '\n') && !feof(stdin)) {
+			while ((c = getchar()) != EOF && c != '\n')
+				;
+			printf("line too long (max %zu characters)\n", sizeof(line) - 2);
+			continue;
+		}
+
+		arg[0] = 0;
+		n = sscanf(line, "%15s %255[^\n]", cmd, arg);
+		if (n < 1)
+			continue;
+
+		len = 1;
+		if (strcmp(cmd, "b") == 0 || strcmp(cmd, "d") == 0) {
+			/* set/delete breakpoint : b|d <addr> */
+			if (sscanf(arg, "%x", &addr) != 1)
+				goto bad;
+			snprintf(req, sizeof(req), "%c0,%x,2", cmd[0] == 'b' ? 'Z' : 'z', addr);
+		} else if (strcmp(cmd, "w") == 0 || strcmp(cmd, "uw") == 0) {
+			/* set/delete write watchpoint : w|uw <addr> [len] */
+			if (sscanf(arg, "%x %u", &addr, &len) < 1)
+				goto bad;
+			snprintf(req, sizeof(req), "%c2,%x,%x", cmd[0] == 'w' ? 'Z' : 'z', addr, len);
+		} else if (strcmp(cmd, "cond") == 0) {
+			/* register condition : cond <Vx|I> <op> <val> | cond clear */
+			snprintf(req, sizeof(req), "cond %s", arg);
+			if (debugger_monitor(fd, req, reply, sizeof(reply)))
+				goto err;
+			if (strcmp(reply, "OK"))
+				printf("bad condition\n");
+			continue;
+		} else if (strcmp(cmd, "s") == 0) {
+			/* single step : s [count] */
+			if (sscanf(arg, "%u", &len) < 1)
+				len = 1;
+			for (i = 0; i < len; i++)
+				if (debugger_send(fd, "s") || debugger_wait_stop(fd))
+					goto err;
+			continue;
+		} else if (strcmp(cmd, "c") == 0) {
+			/* continue until a stop (or Ctrl-C) */
+			if (debugger_send(fd, "c") || debugger_wait_stop(fd))
+				goto err;
+			continue;
+		} else if (strcmp(cmd, "r") == 0) {
+			/* registers */
+			if (debugger_regs(fd, 1))
+				goto err;
+			continue;
+		} else if (strcmp(cmd, "x") == 0) {
+			/* examine memory : x <addr> [len] */
+			len = 16;
+			if (sscanf(arg, "%x %u", &addr, &len) < 1)
+				goto bad;
+			snprintf(req, sizeof(req), "m%x,%x", addr, len);
+			if (debugger_request(fd, req, reply, sizeof(reply)))
+				goto err;
+			if (reply[0] == 'E')
+				printf("can't read memory\n");
+			else
+				debugger_dump(reply, addr);
+			continue;
+		} else if (strcmp(cmd, "q") == 0) {
+			/* detach : program resumes */
+			debugger_request(fd, "D", reply, sizeof(reply));
+			break;
+		} else {
+			goto bad;
+		}
+
+		if (debugger_request(fd, req, reply, sizeof(reply)))
+			goto err;
+		if (strcmp(reply, "OK"))
+			printf("error %s\n", reply);
+		continue;
+bad:
+		printf("commands : b|d <addr>, w|uw <addr> [len], cond <Vx|I> <op> <val>|clear, s [n], c, r, x <addr> [len], q\n");
+	}
+
+	close(fd);
+	return EXIT_SUCCESS;
+err:
+	fprintf(stderr, "Connection closed\n");
+	close(fd);
+	return EXIT_FAILURE;
+usage:
+	fprintf(stderr, "Usage: %s <host> <port>\n", argv[0]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "chip8_export.h"
+
+_Static_assert(sizeof(((struct chip8_shm_frame_t *) 0)->gfx) == CHIP8_GFX_SIZE, "shm display layout");
+_Static_assert(CHIP8_SHM_NR_REGISTERS == CHIP8_NR_REGISTERS, "shm registers layout");
+_Static_assert(CHIP8_SHM_STACK_SIZE == CHIP8_STACK_SIZE, "shm stack layout");
+
+/*
+ * Create a shared memory segment (name must start with '/').
+ */
+int chip8_export_open(struct chip8_export_t *exp, const char *name)
+{
+	void *addr;
+	int fd;
+
+	memset(exp, 0, sizeof(struct chip8_export_t));
+	if (strlen(name) >= CHIP8_EXPORT_NAME_SIZE)
+		return EXIT_FAILURE;
+
+	fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0)
+		return EXIT_FAILURE;
+
+	if (ftruncate(fd, sizeof(struct chip8_shm_t))) {
+		close(fd);
+		shm_unlink(name);
+		return EXIT_FAILURE;
+	}
+
+	addr = mmap(NULL, sizeof(struct chip8_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		shm_unlink(name);
+		return EXIT_FAILURE;
+	}
+
+	/* segment is zero filled : both slots are valid (even sequence), current = 0 */
+	exp->shm = (struct chip8_shm_t *) addr;
+	exp->shm->version = CHIP8_SHM_VERSION;
+	exp->shm->size = sizeof(struct chip8_shm_t);
+	atomic_thread_fence(memory_order_release);
+	exp->shm->magic = CHIP8_SHM_MAGIC;
+	strcpy(exp->name, name);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Publish a frame : fill the slot readers are not pointed to, then switch current.
+ */
+void chip8_export_frame(struct chip8_export_t *exp, const struct chip8_t *chip8)
+{
+	struct chip8_shm_slot_t *slot;
+	struct chip8_shm_frame_t *frame;
+	unsigned int next, seq;
+
+	next = (atomic_load_explicit(&exp->shm->current, memory_order_relaxed) & 1) ^ 1;
+	slot = &exp->shm->slots[next];
+	frame = &slot->frame;
+
+	/* mark slot as being written */
+	seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+	atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	frame->frame = exp->frame++;
+	frame->pc = chip8->pc;
+	frame->I = chip8->I;
+	frame->sp = chip8->sp;
+	memcpy(frame->stack, chip8->stack, sizeof(frame->stack));
+	memcpy(frame->V, chip8->V, sizeof(frame->V));
+	frame->delay_timer = chip8->delay_timer;
+	frame->sound_timer = chip8->sound_timer;
+	frame->hires = chip8->hires;
+	frame->planes = chip8->planes;
+	memcpy(frame->gfx, chip8_gfx_row(chip8, 0, 0), sizeof(frame->gfx));
+
+	/* slot is consistent again, then make it current */
+	atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+	atomic_store_explicit(&exp->shm->current, next, memory_order_release);
+}
+
+/*
+ * Remove a shared memory segment (mapped readers keep it until they close).
+ */
+void chip8_export_close(struct chip8_export_t *exp)
+{
+	if (!exp->shm)
+		return;
+
+	munmap(exp->shm, sizeof(struct chip8_shm_t));
+	shm_unlink(exp->name);
+	exp->shm = NULL;
+}
@@ -0,0 +1,22 @@
+#ifndef _CHIP8_EXPORT_H_
+#define _CHIP8_EXPORT_H_
+
+#include "chip8.h"
+#include "chip8_shm.h"
+
+#define CHIP8_EXPORT_NAME_SIZE		64
+
+/*
+ * Shared memory exporter (writer side of chip8_shm.h).
+ */
+struct chip8_export_t {
+	struct chip8_shm_t *	shm;					/* mapped segment */
+	char			name[CHIP8_EXPORT_NAME_SIZE];		/* segment name */
+	uint64_t		frame;					/* next frame sequence */
+};
+
+int chip8_export_open(struct chip8_export_t *exp, const char *name);
+void chip8_export_frame(struct chip8_export_t *exp, const struct chip8_t *chip8);
+void chip8_export_close(struct chip8_export_t *exp);
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+
+#define CHIP8_FUZZ_MAX_TICKS		10000
+#define CHIP8_FUZZ_KEY_PERIOD		64
+#define CHIP8_FUZZ_MAX_INPUT		(2 + 255 + CHIP8_MEMORY_MAX_SIZE - CHIP8_MEMORY_ROM_START)
+#define CHIP8_FUZZ_MAX_RANDOM		4096
+#define CHIP8_FUZZ_VIP			0x04		/* config byte : VIP timing */
+
+/*
+ * Fuzzed machine : initialized once, then reset between runs.
+ */
+static struct chip8_t *chip8 = NULL;
+
+/*
+ * Quirk profiles, selected by the 2 low bits of the config byte.
+ */
+static const int profiles[] = { CHIP8_PROFILE_COSMAC, CHIP8_PROFILE_SCHIP, CHIP8_PROFILE_XOCHIP, CHIP8_PROFILE_XOCHIP };
+
+/*
+ * Run one fuzz input.
+ *
+ * Input layout :
+ *   byte 0          : config (bits 0-1 = profile, bit 2 = VIP timing)
+ *   byte 1          : number of key events N
+ *   bytes 2 .. N+1  : key events, one applied every CHIP8_FUZZ_KEY_PERIOD ticks of emulated time
+ *                     (low nibble = key, bit 7 = pressed)
+ *   bytes N + 2 ..  : ROM
+ *
+ * Fixed timing runs CHIP8_FUZZ_MAX_TICKS ticks, VIP timing runs frames for the same emulated time.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	const uint8_t *keys;
+	size_t nr_keys;
+	int i, vip, nr_steps, key_period;
+
+	/* create chip8 once (memory for the largest profile), reset it on next runs */
+	if (!chip8) {
+		chip8 = chip8_create(NULL, CHIP8_PROFILE_XOCHIP);
+		if (!chip8)
+			abort();
+	} else {
+		chip8_reset(chip8);
+	}
+
+	/* same random sequence on each run */
+	chip8_seed(chip8, 1);
+
+	/* parse input */
+	if (size < 2)
+		return 0;
+	nr_keys = data[1];
+	if (size < 2 + nr_keys)
+		return 0;
+	keys = data + 2;
+
+	/* profile and timing */
+	vip = data[0] & CHIP8_FUZZ_VIP;
+	chip8_set_timing(chip8, vip ? CHIP8_TIMING_VIP : CHIP8_TIMING_FIXED);
+	if (chip8_set_quirks(chip8, profiles[data[0] & 0x03]))
+		return 0;
+
+	/* load rom */
+	if (chip8_load_rom_buffer(chip8, data + 2 + nr_keys, size - 2 - nr_keys))
+		return 0;
+
+	/* steps = ticks or frames */
+	nr_steps = vip ? CHIP8_FUZZ_MAX_TICKS * CHIP8_TICK_FREQ_US / CHIP8_FRAME_FREQ_US : CHIP8_FUZZ_MAX_TICKS;
+	key_period = vip ? CHIP8_FUZZ_KEY_PERIOD * CHIP8_TICK_FREQ_US / CHIP8_FRAME_FREQ_US : CHIP8_FUZZ_KEY_PERIOD;
+
+	/* run until an error or steps limit */
+	for (i = 0; i < nr_steps; i++) {
+		/* apply next key event */
+		if (i % key_period == 0 && (size_t) (i / key_period) < nr_keys)
+			chip8_key_set(chip8, keys[i / key_period] & 0x0F, keys[i / key_period] >> 7);
+
+		if (vip ? chip8_run_frame(chip8) : chip8_tick(chip8))
+			break;
+	}
+
+	return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+
+/*
+ * Persistent mode driver : replay input files, or run random inputs for a number of seconds.
+ */
+int main(int argc, char **argv)
+{
+	static uint8_t input[CHIP8_FUZZ_MAX_INPUT];
+	struct timespec start, now;
+	uint64_t execs = 0, seed;
+	double elapsed, duration;
+	size_t size, i;
+	FILE *fp;
+	int n;
+
+	/* replay input files */
+	if (argc > 1 && strcmp(argv[1], "-t") != 0) {
+		for (n = 1; n < argc; n++) {
+			fp = fopen(argv[n], "rb");
+			if (!fp) {
+				fprintf(stderr, "Can't open \"%s\"\n", argv[n]);
+				return EXIT_FAILURE;
+			}
+
+			size = fread(input, 1, sizeof(input), fp);
+			fclose(fp);
+
+			LLVMFuzzerTestOneInput(input, size);
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	/* random inputs : silence core errors */
+	if (!freopen("/dev/null", "w", stderr))
+		return EXIT_FAILURE;
+
+	duration = argc > 2 ? atof(argv[2]) : 10.0;
+	seed = time(NULL) | 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		/* generate input (xorshift) */
+		size = 1 + seed % CHIP8_FUZZ_MAX_RANDOM;
+		for (i = 0; i < size; i++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+			input[i] = seed;
+		}
+
+		LLVMFuzzerTestOneInput(input, size);
+		execs++;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+	} while (elapsed < duration);
+
+	printf("%llu execs in %.2f s : %.0f execs/s\n", (unsigned long long) execs, elapsed, execs / elapsed);
+
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "chip8_input.h"
+
+#define HISTOGRAM_BAR_WIDTH	40
+
+/*
+ * Init key input (keycodes are mapped from chip8_keymap, both cases).
+ */
+void chip8_input_init(struct chip8_input_t *input)
+{
+	int i;
+
+	memset(input, 0, sizeof(struct chip8_input_t));
+	memset(input->keymap, CHIP8_INPUT_NO_KEY, sizeof(input->keymap));
+	input->hold_us = CHIP8_INPUT_HOLD_US;
+
+	for (i = 0; i < CHIP8_NR_KEYS; i++) {
+		input->keymap[chip8_keymap[i]] = i;
+		input->keymap[toupper(chip8_keymap[i])] = i;
+	}
+}
+
+/*
+ * Hash display (FNV-1a) : tells frames reflecting an event from frames drawn with the same display.
+ */
+static uint64_t chip8_input_display_hash(const struct chip8_t *chip8)
+{
+	const uint8_t *gfx = (const uint8_t *) chip8_gfx_row(chip8, 0, 0);
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	size_t i;
+
+	hash = (hash ^ chip8->hires) * 0x100000001B3ULL;
+	for (i = 0; i < CHIP8_GFX_SIZE; i++)
+		hash = (hash ^ gfx[i]) * 0x100000001B3ULL;
+
+	return hash;
+}
+
+/*
+ * Queue a key event. Events must be pushed in arrival order (an earlier time is raised to the previous event's).
+ */
+int chip8_input_push(struct chip8_input_t *input, uint8_t key, int pressed, int64_t time_us)
+{
+	struct chip8_input_event_t *ev;
+
+	if (key >= CHIP8_NR_KEYS)
+		return EXIT_FAILURE;
+
+	/* queue full */
+	if (input->head - input->tail == CHIP8_INPUT_QUEUE_SIZE) {
+		input->dropped++;
+		return EXIT_FAILURE;
+	}
+
+	/* keep queue ordered */
+	if (input->head != input->tail) {
+		ev = &input->events[(input->head - 1) & (CHIP8_INPUT_QUEUE_SIZE - 1)];
+		if (time_us < ev->time_us)
+			time_us = ev->time_us;
+	}
+
+	ev = &input->events[input->head & (CHIP8_INPUT_QUEUE_SIZE - 1)];
+	ev->time_us = time_us;
+	ev->key = key;
+	ev->pressed = pressed ? 1 : 0;
+	input->head++;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Queue a key event from a host keycode (unmapped keycodes are ignored).
+ */
+int chip8_input_push_keycode(struct chip8_input_t *input, unsigned int keycode, int pressed, int64_t time_us)
+{
+	uint8_t key = CHIP8_INPUT_KEY(input, keycode);
+
+	if (key == CHIP8_INPUT_NO_KEY)
+		return EXIT_FAILURE;
+
+	return chip8_input_push(input, key, pressed, time_us);
+}
+
+/*
+ * Apply queued events up to emulated time time_us to the keypad (call before each instruction).
+ */
+void chip8_input_apply(struct chip8_input_t *input, struct chip8_t *chip8, int64_t time_us)
+{
+	struct chip8_input_event_t *ev;
+
+	while (input->tail != input->head) {
+		ev = &input->events[input->tail & (CHIP8_INPUT_QUEUE_SIZE - 1)];
+		if (ev->time_us > time_us)
+			break;
+
+		/* short tap : hold release (and following events, to keep order) until key was down long enough */
+		if (!ev->pressed && chip8_key(chip8, ev->key) && input->press_us[ev->key] + input->hold_us > time_us)
+			break;
+
+		if (ev->pressed)
+			input->press_us[ev->key] = time_us;
+		chip8_key_set(chip8, ev->key, ev->pressed);
+		input->tail++;
+
+		/* track latency of this event if none is pending */
+		if (!input->latency_start_us) {
+			input->latency_start_us = ev->time_us;
+			input->latency_hash = chip8_input_display_hash(chip8);
+			input->latency_frame = 0;
+		}
+	}
+}
+
+/*
+ * A frame was produced from the current display : it reflects the tracked event if the display changed since.
+ */
+void chip8_input_frame(struct chip8_input_t *input, const struct chip8_t *chip8)
+{
+	if (input->latency_start_us && !input->latency_frame && chip8_input_display_hash(chip8) != input->latency_hash)
+		input->latency_frame = 1;
+}
+
+/*
+ * A frame was presented : record latency of tracked event if the frame reflects it.
+ */
+void chip8_input_present(struct chip8_input_t *input, int64_t time_us)
+{
+	int64_t latency;
+	int i;
+
+	if (!input->latency_start_us)
+		return;
+
+	latency = time_us - input->latency_start_us;
+
+	/* display not changed by the event (key ignored by the program) */
+	if (!input->latency_frame) {
+		if (latency > CHIP8_INPUT_LATENCY_MAX_US) {
+			input->nr_unanswered++;
+			input->latency_start_us = 0;
+		}
+
+		return;
+	}
+
+	if (latency < 0)
+		latency = 0;
+
+	/* bucket i holds [2^i, 2^(i+1)) us */
+	for (i = 0; i < CHIP8_INPUT_NR_BUCKETS - 1 && (latency >> (i + 1)); i++);
+	input->histogram[i]++;
+
+	input->nr_samples++;
+	input->latency_sum_us += latency;
+	if (latency > input->latency_max_us)
+		input->latency_max_us = latency;
+
+	input->latency_start_us = 0;
+}
+
+/*
+ * Get upper bound of the bucket holding a percentile.
+ */
+static int64_t chip8_input_percentile(const struct chip8_input_t *input, int percent)
+{
+	uint64_t count = 0;
+	int i;
+
+	for (i = 0; i < CHIP8_INPUT_NR_BUCKETS; i++) {
+		count += input->histogram[i];
+		if (count * 100 >= input->nr_samples * percent)
+			break;
+	}
+
+	return (1LL << (i + 1)) - 1;
+}
+
+/*
+ * Print input-to-photon latency histogram.
+ */
+void chip8_input_print_latency(const struct chip8_input_t *input, FILE *fp)
+{
+	uint64_t max_count = 0;
+	int i, first, last, width;
+
+	fprintf(fp, "input latency : %llu samples, %llu unanswered, %llu dropped\n",
+		(unsigned long long) input->nr_samples,
+		(unsigned long long) input->nr_unanswered,
+		(unsigned long long) input->dropped);
+
+	if (!input->nr_samples)
+		return;
+
+	fprintf(fp, "mean %lld us, max %lld us, p50 <= %lld us, p99 <= %lld us\n",
+		(long long) (input->latency_sum_us / (int64_t) input->nr_samples),
+		(long long) input->latency_max_us,
+		(long long) chip8_input_percentile(input, 50),
+		(long long) chip8_input_percentile(input, 99));
+
+	/* print non empty range only */
+	for (first = 0; !input->histogram[first]; first++);
+	for (last = CHIP8_INPUT_NR_BUCKETS - 1; !input->histogram[last]; last--);
+	for (i = first; i <= last; i++)
+		if (input->histogram[i] > max_count)
+			max_count = input->histogram[i];
+
+	for (i = first; i <= last; i++) {
+		width = input->histogram[i] * HISTOGRAM_BAR_WIDTH / max_count;
+		fprintf(fp, "%9lld - %9lld us : %8llu %.*s\n",
+			i ? 1LL << i : 0LL, (1LL << (i + 1)) - 1,
+			(unsigned long long) input->histogram[i],
+			width, "########################################");
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef _CHIP8_INPUT_H_
+#define _CHIP8_INPUT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define CHIP8_INPUT_NR_KEYCODES		256
+#define CHIP8_INPUT_NO_KEY		0xFF
+#define CHIP8_INPUT_QUEUE_SIZE		256		/* power of 2 */
+#define CHIP8_INPUT_HOLD_US		CHIP8_FRAME_FREQ_US	/* default minimum press duration */
+#define CHIP8_INPUT_LATENCY_MAX_US	1000000		/* key events not reflected within 1 s are dropped */
+#define CHIP8_INPUT_NR_BUCKETS		24		/* log2 microsecond buckets (up to ~16 s) */
+
+/* get chip8 key of a keycode (CHIP8_INPUT_NO_KEY if unmapped) */
+#define CHIP8_INPUT_KEY(input, keycode)	((keycode) < CHIP8_INPUT_NR_KEYCODES ? (input)->keymap[keycode] : CHIP8_INPUT_NO_KEY)
+
+/*
+ * Key event, timestamped at arrival (host monotonic clock, us).
+ */
+struct chip8_input_event_t {
+	int64_t			time_us;				/* arrival time */
+	uint8_t			key;					/* chip8 key */
+	uint8_t			pressed;				/* 1 = press, 0 = release */
+};
+
+/*
+ * Key input : keycode lookup table, event queue and input-to-photon latency histogram.
+ *
+ * Events are queued as they arrive and applied to the keypad by chip8_input_apply() right
+ * before the emulated instruction matching their arrival time, so a press and a release
+ * landing between two host frames are both seen by the program. A release is held back
+ * until the key has been down for at least hold_us of emulated time.
+ *
+ * Latency is measured from the arrival of an applied event to the presentation of the
+ * first frame that reflects it (chip8_input_frame() then chip8_input_present()) : a frame
+ * reflects the event if the display changed since the event was applied. Frames drawn
+ * meanwhile with an unchanged display are not counted. Only one event is tracked at a time.
+ */
+struct chip8_input_t {
+	uint8_t			keymap[CHIP8_INPUT_NR_KEYCODES];	/* keycode -> chip8 key (CHIP8_INPUT_NO_KEY = unmapped) */
+	struct chip8_input_event_t events[CHIP8_INPUT_QUEUE_SIZE];	/* event queue */
+	uint32_t		head;					/* next write index */
+	uint32_t		tail;					/* next read index */
+	int64_t			hold_us;				/* minimum press duration */
+	int64_t			press_us[CHIP8_NR_KEYS];		/* emulated time of last applied press */
+	uint64_t		dropped;				/* events dropped because queue was full */
+	int64_t			latency_start_us;			/* arrival time of tracked event (0 = none) */
+	uint64_t		latency_hash;				/* display hash when tracked event was applied */
+	int			latency_frame;				/* 1 if a frame reflecting tracked event was produced */
+	uint64_t		histogram[CHIP8_INPUT_NR_BUCKETS];	/* latency histogram ([2^i, 2^(i+1)) us) */
+	uint64_t		nr_samples;				/* number of latency samples */
+	uint64_t		nr_unanswered;				/* tracked events not changing the display within CHIP8_INPUT_LATENCY_MAX_US */
+	int64_t			latency_sum_us;				/* sum of latencies */
+	int64_t			latency_max_us;				/* max latency */
+};
+
+void chip8_input_init(struct chip8_input_t *input);
+int chip8_input_push(struct chip8_input_t *input, uint8_t key, int pressed, int64_t time_us);
+int chip8_input_push_keycode(struct chip8_input_t *input, unsigned int keycode, int pressed, int64_t time_us);
+void chip8_input_apply(struct chip8_input_t *input, struct chip8_t *chip8, int64_t time_us);
+void chip8_input_frame(struct chip8_input_t *input, const struct chip8_t *chip8);
+void chip8_input_present(struct chip8_input_t *input, int64_t time_us);
+void chip8_input_print_latency(const struct chip8_input_t *input, FILE *fp);
+
+#endif
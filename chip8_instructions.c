@@ -4,12 +4,37 @@
 #include "chip8.h"
 
 /*
- * Clear screen.
+ * Skip next instruction (F000 NNNN is 4 bytes long).
  */
-void chip8_clear_screen(struct chip8_t *chip8)
+static void chip8_skip(struct chip8_t *chip8)
+{
+	if (chip8->memory[CHIP8_ADDR(chip8, chip8->pc + 2)] == 0xF0 && chip8->memory[CHIP8_ADDR(chip8, chip8->pc + 3)] == 0x00)
+		chip8->pc += 6;
+	else
+		chip8->pc += 4;
+}
+
+/*
+ * Mark screen dirty.
+ */
+static void chip8_gfx_changed(struct chip8_t *chip8)
 {
-	memset(chip8->gfx, 0, CHIP8_GFX_SIZE);
 	chip8->draw_flag = 1;
+	chip8->gfx_dirty = 1;
+}
+
+/*
+ * Clear screen (selected planes only).
+ */
+void chip8_clear_screen(struct chip8_t *chip8)
+{
+	int p;
+
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++)
+		if (chip8->planes & (1 << p))
+			memset(chip8->gfx[p], 0, sizeof(chip8->gfx[p]));
+
+	chip8_gfx_changed(chip8);
 	chip8->pc += 2;
 }
 
@@ -47,7 +72,7 @@ void chip8_call_subroutine(struct chip8_t *chip8, uint16_t addr)
 void chip8_skip_if_reg_equal_val(struct chip8_t *chip8, uint8_t x, uint8_t val)
 {
 	if (chip8->V[x] == val)
-		chip8->pc += 4;
+		chip8_skip(chip8);
 	else
 		chip8->pc += 2;
 }
@@ -58,7 +83,7 @@ void chip8_skip_if_reg_equal_val(struct chip8_t *chip8, uint8_t x, uint8_t val)
 void chip8_skip_if_reg_different_val(struct chip8_t *chip8, uint8_t x, uint8_t val)
 {
 	if (chip8->V[x] != val)
-		chip8->pc += 4;
+		chip8_skip(chip8);
 	else
 		chip8->pc += 2;
 }
@@ -69,7 +94,7 @@ void chip8_skip_if_reg_different_val(struct chip8_t *chip8, uint8_t x, uint8_t v
 void chip8_skip_if_reg_equal_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
 	if (chip8->V[x] == chip8->V[y])
-		chip8->pc += 4;
+		chip8_skip(chip8);
 	else
 		chip8->pc += 2;
 }
@@ -80,7 +105,7 @@ void chip8_skip_if_reg_equal_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 void chip8_skip_if_reg_different_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
 	if (chip8->V[x] != chip8->V[y])
-		chip8->pc += 4;
+		chip8_skip(chip8);
 	else
 		chip8->pc += 2;
 }
@@ -118,6 +143,10 @@ void chip8_set_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 void chip8_or_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
 	chip8->V[x] |= chip8->V[y];
+
+	if (chip8->quirks & CHIP8_QUIRK_VF_RESET)
+		chip8->V[0xF] = 0;
+
 	chip8->pc += 2;
 }
 
@@ -127,6 +156,10 @@ void chip8_or_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 void chip8_and_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
 	chip8->V[x] &= chip8->V[y];
+
+	if (chip8->quirks & CHIP8_QUIRK_VF_RESET)
+		chip8->V[0xF] = 0;
+
 	chip8->pc += 2;
 }
 
@@ -136,22 +169,23 @@ void chip8_and_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 void chip8_xor_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
 	chip8->V[x] ^= chip8->V[y];
+
+	if (chip8->quirks & CHIP8_QUIRK_VF_RESET)
+		chip8->V[0xF] = 0;
+
 	chip8->pc += 2;
 }
 
 /*
- * Vx += Vy.
+ * Vx += Vy. Flags are computed from the operands and written last (x may be 0xF).
  */
 void chip8_add_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
-	chip8->V[x] += chip8->V[y];
-
-	/* Set Carry Flag */
-	if (chip8->V[y] > (0xFF - chip8->V[x]))
-		chip8->V[0xF] = 1;
-	else
-		chip8->V[0xF] = 0;
+	/* carry flag */
+	uint8_t carry = chip8->V[x] + chip8->V[y] > 0xFF;
 
+	chip8->V[x] += chip8->V[y];
+	chip8->V[0xF] = carry;
 	chip8->pc += 2;
 }
 
@@ -160,41 +194,38 @@ void chip8_add_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
  */
 void chip8_sub_reg_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
-	/* Set Borrow flag */
-	if (chip8->V[y] > chip8->V[x])
-		chip8->V[0xF] = 0;
-	else
-		chip8->V[0xF] = 1;
+	/* not borrow flag */
+	uint8_t flag = chip8->V[x] >= chip8->V[y];
 
 	chip8->V[x] -= chip8->V[y];
+	chip8->V[0xF] = flag;
 	chip8->pc += 2;
 }
 
 /*
- * Vx >>= 1.
+ * Vx = Vy >> 1 (Vx >>= 1 with shift quirk).
  */
-void chip8_rshift_reg(struct chip8_t *chip8, uint8_t x)
+void chip8_rshift_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
-	/* store least significant bit in Vf */
-	chip8->V[0xF] = chip8->V[x] & 0x1;
+	uint8_t val = chip8->V[chip8->quirks & CHIP8_QUIRK_SHIFT ? x : y];
 
-	/* right shift */
-	chip8->V[x] >>= 1;
+	/* right shift, least significant bit in Vf */
+	chip8->V[x] = val >> 1;
+	chip8->V[0xF] = val & 0x1;
 	chip8->pc += 2;
 }
 
 /*
- * Vx <<= 1.
+ * Vx = Vy << 1 (Vx <<= 1 with shift quirk).
  */
-void chip8_lshift_reg(struct chip8_t *chip8, uint8_t x)
+void chip8_lshift_reg(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
-	/* store most significant bit in Vf */
-	chip8->V[0xF] = chip8->V[x] >> 7;
+	uint8_t val = chip8->V[chip8->quirks & CHIP8_QUIRK_SHIFT ? x : y];
 
-	/* right shift */
-	chip8->V[x] <<= 1;
+	/* left shift, most significant bit in Vf */
+	chip8->V[x] = val << 1;
+	chip8->V[0xF] = val >> 7;
 	chip8->pc += 2;
-
 }
 
 /*
@@ -202,13 +233,39 @@ void chip8_lshift_reg(struct chip8_t *chip8, uint8_t x)
  */
 void chip8_sub_reg_reg_inv(struct chip8_t *chip8, uint8_t x, uint8_t y)
 {
-	/* Set Borrow flag */
-	if (chip8->V[x] > chip8->V[y])
-		chip8->V[0xF] = 0;
-	else
-		chip8->V[0xF] = 1;
+	/* not borrow flag */
+	uint8_t flag = chip8->V[y] >= chip8->V[x];
 
 	chip8->V[x] = chip8->V[y] - chip8->V[x];
+	chip8->V[0xF] = flag;
+	chip8->pc += 2;
+}
+
+/*
+ * Store registers from Vx to Vy (in either order) at I. I is not changed.
+ */
+void chip8_reg_save_range(struct chip8_t *chip8, uint8_t x, uint8_t y)
+{
+	int i, step = x <= y ? 1 : -1;
+
+	for (i = 0; i <= abs(y - x); i++) {
+		chip8->memory[CHIP8_ADDR(chip8, chip8->I + i)] = chip8->V[x + i * step];
+		CHIP8_MEM_DIRTY(chip8, CHIP8_ADDR(chip8, chip8->I + i));
+	}
+
+	chip8->pc += 2;
+}
+
+/*
+ * Load registers from Vx to Vy (in either order) from I. I is not changed.
+ */
+void chip8_reg_load_range(struct chip8_t *chip8, uint8_t x, uint8_t y)
+{
+	int i, step = x <= y ? 1 : -1;
+
+	for (i = 0; i <= abs(y - x); i++)
+		chip8->V[x + i * step] = chip8->memory[CHIP8_ADDR(chip8, chip8->I + i)];
+
 	chip8->pc += 2;
 }
 
@@ -222,68 +279,265 @@ void chip8_set_I(struct chip8_t *chip8, uint16_t addr)
 }
 
 /*
- * PC = V0 + addr.
+ * I = 16 bits address stored after the instruction.
+ */
+void chip8_set_I_long(struct chip8_t *chip8)
+{
+	chip8->I = (chip8->memory[CHIP8_ADDR(chip8, chip8->pc + 2)] << 8) | chip8->memory[CHIP8_ADDR(chip8, chip8->pc + 3)];
+	chip8->pc += 4;
+}
+
+/*
+ * Select drawing planes.
+ */
+void chip8_select_planes(struct chip8_t *chip8, uint8_t n)
+{
+	chip8->planes = n & ((1 << CHIP8_GFX_NR_PLANES) - 1);
+	chip8->pc += 2;
+}
+
+/*
+ * PC = V0 + addr (Vx + addr with jump quirk, x being the high nibble of addr).
  */
 void chip8_jump_plus_v0(struct chip8_t *chip8, uint16_t addr)
 {
-	chip8->pc = chip8->V[0] + addr;
+	chip8->pc = chip8->V[chip8->quirks & CHIP8_QUIRK_JUMP ? (addr >> 8) & 0x0F : 0] + addr;
 }
 
 /*
- * Vx = rand() & val.
+ * Vx = rand() & val (xorshift32 : the sequence is part of the machine state).
  */
 void chip8_rand(struct chip8_t *chip8, uint8_t x, uint8_t val)
 {
-	chip8->V[x] = (rand() % (0xFF + 1)) & val;
+	chip8->rng ^= chip8->rng << 13;
+	chip8->rng ^= chip8->rng >> 17;
+	chip8->rng ^= chip8->rng << 5;
+
+	chip8->V[x] = (chip8->rng >> 24) & val;
 	chip8->pc += 2;
 }
 
+/*
+ * XOR sprite bits (width bits, most significant first) into a display row at x.
+ * Pixels past the right edge wrap around, or are dropped if clip is set.
+ * Returns 1 if any pixel is turned off.
+ */
+static int chip8_draw_row(uint64_t *row, uint64_t bits, int width, int x, int gfx_width, int clip)
+{
+	uint64_t m0, m1, tmp;
+	int collision;
+
+	/* clip : drop rightmost pixels past the edge */
+	if (clip && x + width > gfx_width)
+		bits &= ~((1ULL << (x + width - gfx_width)) - 1);
+
+	/* align sprite on the left of the row */
+	m0 = bits << (64 - width);
+	m1 = 0;
+
+	/* rotate right by x (wrap around the display width) */
+	if (gfx_width == 64) {
+		if (x)
+			m0 = (m0 >> x) | (m0 << (64 - x));
+	} else {
+		if (x >= 64) {
+			tmp = m0;
+			m0 = m1;
+			m1 = tmp;
+			x -= 64;
+		}
+
+		if (x) {
+			tmp = (m0 >> x) | (m1 << (64 - x));
+			m1 = (m1 >> x) | (m0 << (64 - x));
+			m0 = tmp;
+		}
+	}
+
+	/* detect collision and update row */
+	collision = ((row[0] & m0) | (row[1] & m1)) != 0;
+	row[0] ^= m0;
+	row[1] ^= m1;
+
+	return collision;
+}
+
 /*
  * Draw a sprite at coordinate (Vx ; Vy) of width = 8 and height.
- * Each row of 8 pixels is read from memory location I.
- * Vf is set to 1 if any pixels are flipped. 
+ * If height is 0, a 16x16 sprite is drawn. Coordinates wrap, the sprite itself wraps
+ * or is clipped (clip quirk) at display edges.
+ * Each row of the sprite is read from memory location I, one sprite per selected plane.
+ * Vf is set to 1 if any pixels are flipped.
  */
 void chip8_draw(struct chip8_t *chip8, uint8_t x, uint8_t y, uint8_t height)
 {
-	int i, j, val, pos, collision = 0;
+	int gfx_width = CHIP8_GFX_WIDTH(chip8), gfx_height = CHIP8_GFX_HEIGHT(chip8);
+	int i, p, width = 8, collision = 0, clip = chip8->quirks & CHIP8_QUIRK_CLIP;
+	uint16_t addr = chip8->I;
+	uint64_t bits;
+
+	/* 16x16 sprite */
+	if (height == 0) {
+		width = 16;
+		height = 16;
+	}
+
+	/* wrap coordinates */
+	x %= gfx_width;
+	y %= gfx_height;
 
-	/* reset Vf */
-	chip8->V[0xF] = 0;
+	/* draw sprite on each selected plane */
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++) {
+		if (!(chip8->planes & (1 << p)))
+			continue;
 
-	/* draw sprite */
-	for (i = 0; i < height; i++) {
-		for (j = 0; j < 8; j++) {
-			/* get value */
-			val = chip8->memory[chip8->I + i] >> (7 - j) & 1;
-			
-			/* get pixel position */
-			pos = CHIP8_GFX_WIDTH * ((y + i) % CHIP8_GFX_HEIGHT) + ((x + j) % CHIP8_GFX_WIDTH);
+		for (i = 0; i < height; i++) {
+			/* get sprite row */
+			bits = chip8->memory[CHIP8_ADDR(chip8, addr)];
+			if (width == 16)
+				bits = (bits << 8) | chip8->memory[CHIP8_ADDR(chip8, addr + 1)];
+			addr += width / 8;
 
-			/* detect collision */
-			collision |= chip8->gfx[pos] && val;
+			/* clip : rows past the bottom edge are not drawn */
+			if (clip && y + i >= gfx_height)
+				continue;
 
 			/* update gfx */
-			chip8->gfx[pos] ^= val;
+			collision |= chip8_draw_row(chip8->gfx[p][(y + i) % gfx_height], bits, width, x, gfx_width, clip);
 		}
 	}
 
 	/* set Vf if collisions occured */
-	if (collision)
-		chip8->V[0xF] = 1;
-	
+	chip8->V[0xF] = collision;
+
+	/* display wait : idle until next frame */
+	if (chip8->quirks & CHIP8_QUIRK_DISPLAY_WAIT)
+		chip8->display_wait = 1;
+
 	/* set draw flag */
-	chip8->draw_flag = 1;
+	chip8_gfx_changed(chip8);
 	chip8->pc += 2;
 }
 
+/*
+ * Scroll selected planes down n lines.
+ */
+void chip8_scroll_down(struct chip8_t *chip8, uint8_t n)
+{
+	int p, height = CHIP8_GFX_HEIGHT(chip8);
+
+	if (n > height)
+		n = height;
+
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++) {
+		if (!(chip8->planes & (1 << p)))
+			continue;
+
+		memmove(chip8->gfx[p][n], chip8->gfx[p][0], (height - n) * sizeof(chip8->gfx[p][0]));
+		memset(chip8->gfx[p][0], 0, n * sizeof(chip8->gfx[p][0]));
+	}
+
+	chip8_gfx_changed(chip8);
+	chip8->pc += 2;
+}
+
+/*
+ * Scroll selected planes up n lines.
+ */
+void chip8_scroll_up(struct chip8_t *chip8, uint8_t n)
+{
+	int p, height = CHIP8_GFX_HEIGHT(chip8);
+
+	if (n > height)
+		n = height;
+
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++) {
+		if (!(chip8->planes & (1 << p)))
+			continue;
+
+		memmove(chip8->gfx[p][0], chip8->gfx[p][n], (height - n) * sizeof(chip8->gfx[p][0]));
+		memset(chip8->gfx[p][height - n], 0, n * sizeof(chip8->gfx[p][0]));
+	}
+
+	chip8_gfx_changed(chip8);
+	chip8->pc += 2;
+}
+
+/*
+ * Scroll selected planes right 4 pixels.
+ */
+void chip8_scroll_right(struct chip8_t *chip8)
+{
+	int p, y, height = CHIP8_GFX_HEIGHT(chip8);
+	uint64_t *row;
+
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++) {
+		if (!(chip8->planes & (1 << p)))
+			continue;
+
+		for (y = 0; y < height; y++) {
+			row = chip8->gfx[p][y];
+
+			/* in low resolution, pixels must not leak in the second word */
+			if (chip8->hires)
+				row[1] = (row[1] >> 4) | (row[0] << 60);
+			row[0] >>= 4;
+		}
+	}
+
+	chip8_gfx_changed(chip8);
+	chip8->pc += 2;
+}
+
+/*
+ * Scroll selected planes left 4 pixels.
+ */
+void chip8_scroll_left(struct chip8_t *chip8)
+{
+	int p, y, height = CHIP8_GFX_HEIGHT(chip8);
+	uint64_t *row;
+
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++) {
+		if (!(chip8->planes & (1 << p)))
+			continue;
+
+		for (y = 0; y < height; y++) {
+			row = chip8->gfx[p][y];
+			row[0] = (row[0] << 4) | (row[1] >> 60);
+			row[1] <<= 4;
+		}
+	}
+
+	chip8_gfx_changed(chip8);
+	chip8->pc += 2;
+}
+
+/*
+ * Exit interpreter : pc is not incremented, so the machine loops on this instruction.
+ */
+void chip8_exit(struct chip8_t *chip8)
+{
+	(void) chip8;
+}
+
+/*
+ * Switch between low (64x32) and high (128x64) resolution. The display is cleared.
+ */
+void chip8_set_hires(struct chip8_t *chip8, uint8_t hires)
+{
+	chip8->hires = hires;
+	memset(chip8->gfx, 0, CHIP8_GFX_SIZE);
+	chip8_gfx_changed(chip8);
+	chip8->pc += 2;
+}
 
 /*
  * Skip next instruction if the key stored in Vx is pressed.
  */
 void chip8_skip_if_key_pressed(struct chip8_t *chip8, uint8_t x)
 {
-	if (chip8->key[chip8->V[x]] != 0)
-		chip8->pc += 4;
+	if (chip8->key[chip8->V[x] & 0x0F] != 0)
+		chip8_skip(chip8);
 	else
 		chip8->pc += 2;
 }
@@ -293,8 +547,8 @@ void chip8_skip_if_key_pressed(struct chip8_t *chip8, uint8_t x)
  */
 void chip8_skip_if_key_not_pressed(struct chip8_t *chip8, uint8_t x)
 {
-	if (chip8->key[chip8->V[x]] == 0)
-		chip8->pc += 4;
+	if (chip8->key[chip8->V[x] & 0x0F] == 0)
+		chip8_skip(chip8);
 	else
 		chip8->pc += 2;
 }
@@ -348,6 +602,29 @@ void chip8_set_sound_timer(struct chip8_t *chip8, uint8_t x)
 	chip8->pc += 2;
 }
 
+/*
+ * Load the 16 bytes audio pattern stored at I.
+ */
+void chip8_load_pattern(struct chip8_t *chip8)
+{
+	int i;
+
+	for (i = 0; i < CHIP8_AUDIO_PATTERN_SIZE; i++)
+		chip8->pattern[i] = chip8->memory[CHIP8_ADDR(chip8, chip8->I + i)];
+
+	chip8->pattern_flag = 1;
+	chip8->pc += 2;
+}
+
+/*
+ * pitch = Vx.
+ */
+void chip8_set_pitch(struct chip8_t *chip8, uint8_t x)
+{
+	chip8->pitch = chip8->V[x];
+	chip8->pc += 2;
+}
+
 /*
  * I += Vx.
  */
@@ -371,41 +648,77 @@ void chip8_sprite_addr(struct chip8_t *chip8, uint8_t x)
 	chip8->pc += 2;
 }
 
+/*
+ * Set I to the location of the big (8x10) sprite for the character in Vx.
+ */
+void chip8_bigsprite_addr(struct chip8_t *chip8, uint8_t x)
+{
+	chip8->I = CHIP8_BIGFONT_ADDR + (chip8->V[x] & 0x0F) * CHIP8_BIGFONT_SIZE;
+	chip8->pc += 2;
+}
+
 /*
  * Store the binary-coded decimal representation of Vx at I, I+1 and I+2.
  */
 void chip8_bcd(struct chip8_t *chip8, uint8_t x)
 {
-	chip8->memory[chip8->I] = chip8->V[x] / 100;
-	chip8->memory[chip8->I + 1] = (chip8->V[x] / 10) % 10;
-	chip8->memory[chip8->I + 2] = chip8->V[x] % 10;
+	int i;
+
+	for (i = 0; i < 3; i++)
+		CHIP8_MEM_DIRTY(chip8, CHIP8_ADDR(chip8, chip8->I + i));
+
+	chip8->memory[CHIP8_ADDR(chip8, chip8->I)] = chip8->V[x] / 100;
+	chip8->memory[CHIP8_ADDR(chip8, chip8->I + 1)] = (chip8->V[x] / 10) % 10;
+	chip8->memory[CHIP8_ADDR(chip8, chip8->I + 2)] = chip8->V[x] % 10;
 	chip8->pc += 2;
 }
 
 /*
- * Store registers from V0 to Vx (including Vx) at I.
+ * Store registers from V0 to Vx (including Vx) at I, then I += x + 1 (unless load/store quirk).
  */
 void chip8_reg_dump(struct chip8_t *chip8, uint8_t x)
 {
 	int i;
 
-	for (i = 0; i <= x; i++)
-		chip8->memory[chip8->I + i] = chip8->V[i];
+	for (i = 0; i <= x; i++) {
+		chip8->memory[CHIP8_ADDR(chip8, chip8->I + i)] = chip8->V[i];
+		CHIP8_MEM_DIRTY(chip8, CHIP8_ADDR(chip8, chip8->I + i));
+	}
 
- 	chip8->I += x + 1;
+	if (!(chip8->quirks & CHIP8_QUIRK_LOAD_STORE))
+		chip8->I += x + 1;
 	chip8->pc += 2;
 }
 
 /*
- * Fills registers from V0 to Vx (including Vx) with values stored at I.
+ * Fills registers from V0 to Vx (including Vx) with values stored at I, then I += x + 1 (unless load/store quirk).
  */
 void chip8_reg_load(struct chip8_t *chip8, uint8_t x)
 {
 	int i;
 
 	for (i = 0; i <= x; i++)
-		chip8->V[i] = chip8->memory[chip8->I + i];
+		chip8->V[i] = chip8->memory[CHIP8_ADDR(chip8, chip8->I + i)];
 
- 	chip8->I += x + 1;
+	if (!(chip8->quirks & CHIP8_QUIRK_LOAD_STORE))
+		chip8->I += x + 1;
+	chip8->pc += 2;
+}
+
+/*
+ * Store registers from V0 to Vx (including Vx) in RPL user flags.
+ */
+void chip8_rpl_save(struct chip8_t *chip8, uint8_t x)
+{
+	memcpy(chip8->rpl, chip8->V, x + 1);
+	chip8->pc += 2;
+}
+
+/*
+ * Fills registers from V0 to Vx (including Vx) with RPL user flags.
+ */
+void chip8_rpl_load(struct chip8_t *chip8, uint8_t x)
+{
+	memcpy(chip8->V, chip8->rpl, x + 1);
 	chip8->pc += 2;
 }
@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "chip8_netplay.h"
+
+#define NO_ROLLBACK		UINT32_MAX
+
+/*
+ * Get monotonic time in microseconds.
+ */
+static uint64_t netplay_clock_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Emulate a frame with the recorded inputs.
+ */
+static int netplay_emulate(struct chip8_netplay_t *np, uint32_t frame)
+{
+	uint16_t keys = np->local_inputs[frame % CHIP8_NETPLAY_HISTORY] | np->remote_inputs[frame % CHIP8_NETPLAY_HISTORY];
+	uint64_t nr_ticks;
+	int i;
+
+	/* set keypad */
+	for (i = 0; i < CHIP8_NR_KEYS; i++)
+		chip8_key_set(np->chip8, i, (keys >> i) & 1);
+
+	/* number of ticks only depends on frame number */
+	nr_ticks = (uint64_t) (frame + 1) * CHIP8_FRAME_FREQ_US / CHIP8_TICK_FREQ_US
+		 - (uint64_t) frame * CHIP8_FRAME_FREQ_US / CHIP8_TICK_FREQ_US;
+
+	while (nr_ticks--)
+		if (chip8_tick(np->chip8))
+			return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Send a packet (through simulated latency and loss if enabled).
+ */
+static void netplay_send_packet(struct chip8_netplay_t *np, const uint8_t *data, uint64_t now_us)
+{
+	struct chip8_netplay_packet_t *packet;
+
+	/* simulated loss */
+	if (np->loss && (uint32_t) rand_r(&np->loss_seed) % 100 < np->loss)
+		return;
+
+	/* simulated latency */
+	if (np->latency_us && np->nr_delayed < CHIP8_NETPLAY_MAX_DELAYED) {
+		packet = &np->delayed[np->nr_delayed++];
+		packet->due_us = now_us + np->latency_us;
+		memcpy(packet->data, data, CHIP8_NETPLAY_PACKET_SIZE);
+		return;
+	}
+
+	sendto(np->fd, data, CHIP8_NETPLAY_PACKET_SIZE, 0, (struct sockaddr *) &np->remote, sizeof(np->remote));
+}
+
+/*
+ * Send local inputs not acknowledged yet, and acknowledge received remote inputs.
+ */
+static void netplay_send_inputs(struct chip8_netplay_t *np, uint64_t now_us)
+{
+	uint8_t data[CHIP8_NETPLAY_PACKET_SIZE];
+	uint32_t first, count, i;
+
+	/* an older acknowledgement was lost : frames before np->frame - CHIP8_NETPLAY_REDUNDANCY were received */
+	first = np->local_acked;
+	if (np->frame - first > CHIP8_NETPLAY_REDUNDANCY)
+		first = np->frame - CHIP8_NETPLAY_REDUNDANCY;
+	count = np->frame - first;
+
+	memset(data, 0, sizeof(data));
+	data[0] = 'C';
+	data[1] = '8';
+	data[2] = first >> 24;
+	data[3] = first >> 16;
+	data[4] = first >> 8;
+	data[5] = first;
+	data[6] = np->remote_frame >> 24;
+	data[7] = np->remote_frame >> 16;
+	data[8] = np->remote_frame >> 8;
+	data[9] = np->remote_frame;
+	data[10] = count;
+
+	for (i = 0; i < count; i++) {
+		data[11 + 2 * i] = np->local_inputs[(first + i) % CHIP8_NETPLAY_HISTORY] >> 8;
+		data[12 + 2 * i] = np->local_inputs[(first + i) % CHIP8_NETPLAY_HISTORY];
+	}
+
+	netplay_send_packet(np, data, now_us);
+}
+
+/*
+ * Handle a received packet.
+ */
+static void netplay_receive(struct chip8_netplay_t *np, const uint8_t *data)
+{
+	uint32_t first, ack, frame, i;
+	uint16_t input;
+
+	first = ((uint32_t) data[2] << 24) | (data[3] << 16) | (data[4] << 8) | data[5];
+	ack = ((uint32_t) data[6] << 24) | (data[7] << 16) | (data[8] << 8) | data[9];
+
+	/* local inputs received by remote */
+	if (ack > np->local_acked && ack <= np->frame)
+		np->local_acked = ack;
+
+	for (i = 0; i < data[10] && i < CHIP8_NETPLAY_REDUNDANCY; i++) {
+		frame = first + i;
+
+		/* already received */
+		if (frame < np->remote_frame)
+			continue;
+
+		/* gap (lost packet) or too far ahead : wait for a later packet */
+		if (frame > np->remote_frame || frame >= np->frame + CHIP8_NETPLAY_MAX_ROLLBACK)
+			break;
+
+		input = (data[11 + 2 * i] << 8) | data[12 + 2 * i];
+
+		/* frame already emulated with a wrong prediction : roll back */
+		if (frame < np->frame && np->remote_inputs[frame % CHIP8_NETPLAY_HISTORY] != input && frame < np->rollback_frame)
+			np->rollback_frame = frame;
+
+		np->remote_inputs[frame % CHIP8_NETPLAY_HISTORY] = input;
+		np->remote_last = input;
+		np->remote_frame++;
+	}
+}
+
+/*
+ * Send due simulated packets and receive remote inputs.
+ */
+void chip8_netplay_poll(struct chip8_netplay_t *np, uint64_t now_us)
+{
+	uint8_t data[CHIP8_NETPLAY_PACKET_SIZE];
+	uint32_t i, n;
+
+	/* send due delayed packets (constant latency : queue is ordered) */
+	for (n = 0; n < np->nr_delayed && np->delayed[n].due_us <= now_us; n++)
+		sendto(np->fd, np->delayed[n].data, CHIP8_NETPLAY_PACKET_SIZE, 0, (struct sockaddr *) &np->remote, sizeof(np->remote));
+
+	for (i = n; i < np->nr_delayed; i++)
+		np->delayed[i - n] = np->delayed[i];
+	np->nr_delayed -= n;
+
+	/* receive packets */
+	while (recv(np->fd, data, sizeof(data), MSG_DONTWAIT) == CHIP8_NETPLAY_PACKET_SIZE)
+		if (data[0] == 'C' && data[1] == '8')
+			netplay_receive(np, data);
+}
+
+/*
+ * Init a netplay session (both sides must load the same ROM before).
+ */
+int chip8_netplay_init(struct chip8_netplay_t *np, struct chip8_t *chip8, uint16_t local_port, const char *remote_host, uint16_t remote_port)
+{
+	struct sockaddr_in sin;
+	int i;
+
+	memset(np, 0, sizeof(struct chip8_netplay_t));
+	np->chip8 = chip8;
+	np->rollback_frame = NO_ROLLBACK;
+	np->loss_seed = 1;
+
+	/* both sides use the same random sequence */
+	chip8_seed(chip8, CHIP8_NETPLAY_SEED);
+
+	/* remote address */
+	np->remote.sin_family = AF_INET;
+	np->remote.sin_port = htons(remote_port);
+	if (inet_pton(AF_INET, remote_host, &np->remote.sin_addr) != 1)
+		return EXIT_FAILURE;
+
+	/* local socket */
+	np->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (np->fd < 0)
+		return EXIT_FAILURE;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(local_port);
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(np->fd, (struct sockaddr *) &sin, sizeof(sin))) {
+		close(np->fd);
+		return EXIT_FAILURE;
+	}
+
+	/* snapshots memory (sized for chip8 memory) */
+	for (i = 0; i < CHIP8_NETPLAY_HISTORY; i++) {
+		if (chip8_state_init(&np->snapshots[i], chip8)) {
+			chip8_netplay_close(np);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Simulate network latency and packet loss (percent) on sent packets.
+ */
+void chip8_netplay_simulate(struct chip8_netplay_t *np, uint32_t latency_us, uint32_t loss)
+{
+	np->latency_us = latency_us;
+	np->loss = loss;
+}
+
+/*
+ * Emulate next frame : roll back if remote inputs were mispredicted, then emulate
+ * the frame with local input and predicted remote input.
+ */
+enum chip8_netplay_status_t chip8_netplay_frame(struct chip8_netplay_t *np, uint16_t local_input, uint64_t now_us)
+{
+	uint64_t start_us, rollback_us;
+	uint32_t frame;
+
+	/* get remote inputs */
+	chip8_netplay_poll(np, now_us);
+
+	/* roll back to first mispredicted frame and re-simulate */
+	if (np->rollback_frame != NO_ROLLBACK) {
+		start_us = netplay_clock_us();
+
+		/* predict again unconfirmed remote inputs */
+		for (frame = np->remote_frame; frame < np->frame; frame++)
+			np->remote_inputs[frame % CHIP8_NETPLAY_HISTORY] = np->remote_last;
+
+		chip8_load_state(np->chip8, &np->snapshots[np->rollback_frame % CHIP8_NETPLAY_HISTORY]);
+		for (frame = np->rollback_frame; frame < np->frame; frame++) {
+			if (frame != np->rollback_frame)
+				chip8_save_state(np->chip8, &np->snapshots[frame % CHIP8_NETPLAY_HISTORY]);
+
+			if (netplay_emulate(np, frame))
+				return CHIP8_NETPLAY_ERROR;
+
+			np->nr_resim_frames++;
+		}
+
+		rollback_us = netplay_clock_us() - start_us;
+		if (rollback_us > np->max_rollback_us)
+			np->max_rollback_us = rollback_us;
+
+		np->rollback_frame = NO_ROLLBACK;
+		np->nr_rollbacks++;
+	}
+
+	/* too far ahead of remote : wait (but keep sending inputs) */
+	if (np->frame >= np->remote_frame + CHIP8_NETPLAY_MAX_ROLLBACK) {
+		netplay_send_inputs(np, now_us);
+		return CHIP8_NETPLAY_WAITING;
+	}
+
+	/* record inputs (remote input may already be known) */
+	np->local_inputs[np->frame % CHIP8_NETPLAY_HISTORY] = local_input;
+	if (np->frame >= np->remote_frame)
+		np->remote_inputs[np->frame % CHIP8_NETPLAY_HISTORY] = np->remote_last;
+
+	/* save state and emulate frame */
+	chip8_save_state(np->chip8, &np->snapshots[np->frame % CHIP8_NETPLAY_HISTORY]);
+	if (netplay_emulate(np, np->frame))
+		return CHIP8_NETPLAY_ERROR;
+
+	np->frame++;
+	netplay_send_inputs(np, now_us);
+
+	return CHIP8_NETPLAY_ADVANCED;
+}
+
+/*
+ * Close a netplay session.
+ */
+void chip8_netplay_close(struct chip8_netplay_t *np)
+{
+	int i;
+
+	close(np->fd);
+
+	for (i = 0; i < CHIP8_NETPLAY_HISTORY; i++)
+		chip8_state_free(&np->snapshots[i]);
+}
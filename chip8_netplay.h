@@ -0,0 +1,69 @@
+#ifndef _CHIP8_NETPLAY_H_
+#define _CHIP8_NETPLAY_H_
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "chip8.h"
+
+#define CHIP8_NETPLAY_MAX_ROLLBACK	8			/* frames predicted ahead of remote input */
+#define CHIP8_NETPLAY_HISTORY		16			/* power of 2, > CHIP8_NETPLAY_MAX_ROLLBACK */
+#define CHIP8_NETPLAY_REDUNDANCY	(2 * CHIP8_NETPLAY_MAX_ROLLBACK)	/* max unacknowledged local inputs, <= CHIP8_NETPLAY_HISTORY */
+#define CHIP8_NETPLAY_MAX_DELAYED	256			/* simulated in flight packets */
+#define CHIP8_NETPLAY_PACKET_SIZE	(2 + 4 + 4 + 1 + 2 * CHIP8_NETPLAY_REDUNDANCY)
+#define CHIP8_NETPLAY_SEED		0xC8C8C8C8		/* random seed shared by both sides */
+
+/*
+ * Frame status.
+ */
+enum chip8_netplay_status_t {
+	CHIP8_NETPLAY_ADVANCED,					/* frame emulated */
+	CHIP8_NETPLAY_WAITING,					/* too far ahead of remote : frame not emulated */
+	CHIP8_NETPLAY_ERROR,					/* chip8 error */
+};
+
+/*
+ * Simulated in flight packet.
+ */
+struct chip8_netplay_packet_t {
+	uint64_t	due_us;					/* send time */
+	uint8_t		data[CHIP8_NETPLAY_PACKET_SIZE];	/* packet */
+};
+
+/*
+ * Rollback netplay session. Keypads of both sides are merged (local | remote).
+ *
+ * Each packet acknowledges the remote inputs received so far and carries every local input
+ * not acknowledged yet. A side runs at most CHIP8_NETPLAY_MAX_ROLLBACK frames ahead of the
+ * inputs it received, so at most CHIP8_NETPLAY_REDUNDANCY local inputs are ever unacknowledged :
+ * any packet getting through after a burst of losses fills the gap.
+ */
+struct chip8_netplay_t {
+	struct chip8_t *		chip8;						/* chip8 device */
+	int				fd;						/* UDP socket */
+	struct sockaddr_in		remote;						/* remote address */
+	uint32_t			frame;						/* next frame to emulate */
+	uint32_t			remote_frame;					/* remote inputs received for frames < remote_frame */
+	uint32_t			local_acked;					/* local inputs acknowledged by remote for frames < local_acked */
+	uint16_t			remote_last;					/* last received remote input (prediction) */
+	uint32_t			rollback_frame;					/* first mispredicted frame (UINT32_MAX = none) */
+	uint16_t			local_inputs[CHIP8_NETPLAY_HISTORY];		/* local inputs */
+	uint16_t			remote_inputs[CHIP8_NETPLAY_HISTORY];		/* remote inputs (received or predicted) */
+	struct chip8_state_t		snapshots[CHIP8_NETPLAY_HISTORY];		/* state at the start of each frame */
+	uint32_t			latency_us;					/* simulated latency */
+	uint32_t			loss;						/* simulated packet loss (percent) */
+	uint32_t			loss_seed;					/* packet loss random state */
+	struct chip8_netplay_packet_t	delayed[CHIP8_NETPLAY_MAX_DELAYED];		/* simulated in flight packets */
+	uint32_t			nr_delayed;					/* number of in flight packets */
+	uint64_t			nr_rollbacks;					/* number of rollbacks */
+	uint64_t			nr_resim_frames;				/* number of re-simulated frames */
+	uint64_t			max_rollback_us;				/* longest rollback (restore + re-simulation) */
+};
+
+int chip8_netplay_init(struct chip8_netplay_t *np, struct chip8_t *chip8, uint16_t local_port, const char *remote_host, uint16_t remote_port);
+void chip8_netplay_simulate(struct chip8_netplay_t *np, uint32_t latency_us, uint32_t loss);
+enum chip8_netplay_status_t chip8_netplay_frame(struct chip8_netplay_t *np, uint16_t local_input, uint64_t now_us);
+void chip8_netplay_poll(struct chip8_netplay_t *np, uint64_t now_us);
+void chip8_netplay_close(struct chip8_netplay_t *np);
+
+#endif
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "chip8_netplay.h"
+
+#define DEFAULT_NR_FRAMES	3600
+#define DEFAULT_PORT		9000
+#define INPUT_PERIOD		12
+#define BENCH_ITERATIONS	1000
+#define STALL_MARGIN		DEFAULT_NR_FRAMES	/* virtual frames allowed past 2 * nr_frames (waits on lost packets) */
+
+/*
+ * Loopback peer.
+ */
+struct peer_t {
+	struct chip8_t *	chip8;		/* chip8 device */
+	struct chip8_netplay_t	np;		/* netplay session */
+	uint32_t		rng;		/* input script random state */
+	uint16_t		input;		/* current input */
+};
+
+/*
+ * Get monotonic time in microseconds.
+ */
+static uint64_t clock_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Hash chip8 state (FNV-1a).
+ */
+static uint64_t chip8_hash(struct chip8_t *chip8)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	size_t i;
+
+#define HASH(buf, len)	for (i = 0; i < (len); i++) hash = (hash ^ ((const uint8_t *) (buf))[i]) * 0x100000001B3ULL
+	HASH(chip8->V, sizeof(chip8->V));
+	HASH(chip8->stack, sizeof(chip8->stack));
+	HASH(&chip8->sp, sizeof(chip8->sp));
+	HASH(&chip8->pc, sizeof(chip8->pc));
+	HASH(&chip8->I, sizeof(chip8->I));
+	HASH(&chip8->delay_timer, sizeof(chip8->delay_timer));
+	HASH(&chip8->sound_timer, sizeof(chip8->sound_timer));
+	HASH(chip8_gfx_row(chip8, 0, 0), CHIP8_GFX_SIZE);
+	HASH(chip8_mem(chip8, 0), chip8->mem_size);
+#undef HASH
+
+	return hash;
+}
+
+/*
+ * Next scripted input : random keys held for a few frames.
+ */
+static uint16_t peer_input(struct peer_t *peer, uint32_t frame)
+{
+	if (frame % INPUT_PERIOD == 0) {
+		peer->rng ^= peer->rng << 13;
+		peer->rng ^= peer->rng >> 17;
+		peer->rng ^= peer->rng << 5;
+		peer->input = peer->rng & 0xFFFF;
+	}
+
+	return peer->input;
+}
+
+/*
+ * Run two netplay peers over loopback with simulated latency and packet loss,
+ * then check both sides agree on the state of a frame confirmed by both.
+ */
+int main(int argc, char **argv)
+{
+	uint32_t latency_ms = 50, loss = 10, nr_frames = DEFAULT_NR_FRAMES, check_frame, vframe;
+	uint64_t now_us = 0, start_us, hash[2];
+	struct chip8_t *bench;
+	static struct peer_t peers[2];
+	int opt, port = DEFAULT_PORT, i, j;
+	enum chip8_netplay_status_t status;
+	double bench_us;
+
+	/* parse options */
+	while ((opt = getopt(argc, argv, "l:p:n:P:")) != -1) {
+		switch (opt) {
+			case 'l':
+				latency_ms = atoi(optarg);
+				break;
+			case 'p':
+				loss = atoi(optarg);
+				break;
+			case 'n':
+				nr_frames = atoi(optarg);
+				break;
+			case 'P':
+				port = atoi(optarg);
+				break;
+			default:
+				goto usage;
+		}
+	}
+
+	/* check arguments */
+	if (optind != argc - 1)
+		goto usage;
+
+	/* create peers */
+	for (i = 0; i < 2; i++) {
+		peers[i].chip8 = chip8_create(NULL, CHIP8_PROFILE_DEFAULT);
+		if (!peers[i].chip8 || chip8_load_rom(peers[i].chip8, argv[optind])) {
+			fprintf(stderr, "Can't load ROM \"%s\"\n", argv[optind]);
+			return EXIT_FAILURE;
+		}
+
+		if (chip8_netplay_init(&peers[i].np, peers[i].chip8, port + i, "127.0.0.1", port + 1 - i)) {
+			perror("Can't create netplay session");
+			return EXIT_FAILURE;
+		}
+
+		chip8_netplay_simulate(&peers[i].np, latency_ms * 1000, loss);
+		peers[i].rng = 0x1234 + i;
+	}
+
+	/* run both peers on a virtual 60 Hz clock until both have confirmed all frames */
+	check_frame = nr_frames;
+	for (vframe = 0; ; vframe++) {
+		/* protocol stalled : fail instead of hanging */
+		if (vframe > 2 * nr_frames + STALL_MARGIN) {
+			fprintf(stderr, "stalled at frame %u\n", peers[0].np.frame < peers[1].np.frame ? peers[0].np.frame : peers[1].np.frame);
+			return EXIT_FAILURE;
+		}
+
+		for (i = 0; i < 2; i++) {
+			status = chip8_netplay_frame(&peers[i].np, peer_input(&peers[i], peers[i].np.frame), now_us);
+			if (status == CHIP8_NETPLAY_ERROR) {
+				fprintf(stderr, "Peer %d : chip8 error\n", i);
+				return EXIT_FAILURE;
+			}
+		}
+
+		for (i = 0; i < 2; i++)
+			if (peers[i].np.frame <= check_frame || peers[i].np.remote_frame < check_frame)
+				break;
+		if (i == 2)
+			break;
+
+		now_us += CHIP8_FRAME_FREQ_US;
+	}
+
+	printf("%u virtual frames\n", vframe);
+
+	/* compare state at the start of check frame */
+	for (i = 0; i < 2; i++) {
+		chip8_load_state(peers[i].chip8, &peers[i].np.snapshots[check_frame % CHIP8_NETPLAY_HISTORY]);
+		hash[i] = chip8_hash(peers[i].chip8);
+
+		printf("peer %d : %u frames, %llu rollbacks, %llu re-simulated frames, longest rollback %llu us, state %016llx\n",
+		       i, peers[i].np.frame,
+		       (unsigned long long) peers[i].np.nr_rollbacks,
+		       (unsigned long long) peers[i].np.nr_resim_frames,
+		       (unsigned long long) peers[i].np.max_rollback_us,
+		       (unsigned long long) hash[i]);
+	}
+
+	/* cost of a worst case rollback : restore snapshot and re-simulate CHIP8_NETPLAY_MAX_ROLLBACK frames */
+	bench = chip8_create(NULL, CHIP8_PROFILE_DEFAULT);
+	if (!bench)
+		return EXIT_FAILURE;
+	start_us = clock_us();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		chip8_load_state(bench, &peers[0].np.snapshots[check_frame % CHIP8_NETPLAY_HISTORY]);
+		for (j = 0; j < CHIP8_NETPLAY_MAX_ROLLBACK * CHIP8_FRAME_FREQ_US / CHIP8_TICK_FREQ_US; j++)
+			chip8_tick(bench);
+		chip8_save_state(bench, &peers[1].np.snapshots[0]);
+	}
+	bench_us = (double) (clock_us() - start_us) / BENCH_ITERATIONS;
+	printf("%d frames rollback : %.2f us (%.2f %% of a frame)\n",
+	       CHIP8_NETPLAY_MAX_ROLLBACK, bench_us, 100.0 * bench_us / CHIP8_FRAME_FREQ_US);
+
+	chip8_destroy(bench);
+	for (i = 0; i < 2; i++) {
+		chip8_netplay_close(&peers[i].np);
+		chip8_destroy(peers[i].chip8);
+	}
+
+	if (hash[0] != hash[1]) {
+		fprintf(stderr, "Desync at frame %u\n", check_frame);
+		return EXIT_FAILURE;
+	}
+
+	printf("in sync at frame %u\n", check_frame);
+	return EXIT_SUCCESS;
+usage:
+	fprintf(stderr, "Usage: %s [-l latency_ms] [-p loss_percent] [-n frames] [-P port] <rom>\n", argv[0]);
+	return EXIT_FAILURE;
+}
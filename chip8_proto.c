@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_proto.h"
+
+/*
+ * Write a 16 bits integer.
+ */
+void chip8_proto_put16(uint8_t *buf, uint16_t val)
+{
+	buf[0] = val >> 8;
+	buf[1] = val;
+}
+
+/*
+ * Write a 32 bits integer.
+ */
+void chip8_proto_put32(uint8_t *buf, uint32_t val)
+{
+	buf[0] = val >> 24;
+	buf[1] = val >> 16;
+	buf[2] = val >> 8;
+	buf[3] = val;
+}
+
+/*
+ * Read a 16 bits integer.
+ */
+uint16_t chip8_proto_get16(const uint8_t *buf)
+{
+	return (buf[0] << 8) | buf[1];
+}
+
+/*
+ * Read a 32 bits integer.
+ */
+uint32_t chip8_proto_get32(const uint8_t *buf)
+{
+	return ((uint32_t) buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+/*
+ * Serialize a display row (all planes).
+ */
+void chip8_proto_row(struct chip8_t *chip8, int y, uint8_t *row)
+{
+	int p, w, i;
+
+	for (p = 0; p < CHIP8_GFX_NR_PLANES; p++)
+		for (w = 0; w < CHIP8_GFX_ROW_WORDS; w++)
+			for (i = 0; i < 8; i++)
+				*row++ = chip8_gfx_row(chip8, p, y)[w] >> (56 - 8 * i);
+}
+
+/*
+ * Encode a row against the previous one. Returns encoded length.
+ */
+size_t chip8_proto_encode_row(const uint8_t *prev, const uint8_t *row, uint8_t *out)
+{
+	uint8_t delta[CHIP8_PROTO_ROW_SIZE];
+	size_t i, j, len = 0;
+
+	for (i = 0; i < CHIP8_PROTO_ROW_SIZE; i++)
+		delta[i] = prev[i] ^ row[i];
+
+	for (i = 0; i < CHIP8_PROTO_ROW_SIZE; i = j) {
+		if (delta[i] == 0) {
+			/* zero run */
+			for (j = i; j < CHIP8_PROTO_ROW_SIZE && j - i < 128 && delta[j] == 0; j++);
+			out[len++] = 0x80 | (j - i - 1);
+		} else {
+			/* literal run */
+			for (j = i; j < CHIP8_PROTO_ROW_SIZE && j - i < 128 && delta[j] != 0; j++);
+			out[len++] = j - i - 1;
+			memcpy(out + len, delta + i, j - i);
+			len += j - i;
+		}
+	}
+
+	return len;
+}
+
+/*
+ * Decode a row and apply it to the previous one.
+ */
+int chip8_proto_decode_row(const uint8_t *in, size_t len, uint8_t *row)
+{
+	size_t i = 0, pos = 0, n;
+
+	while (i < len) {
+		n = (in[i] & 0x7F) + 1;
+		if (pos + n > CHIP8_PROTO_ROW_SIZE)
+			return EXIT_FAILURE;
+
+		if (in[i++] & 0x80) {
+			pos += n;
+			continue;
+		}
+
+		if (i + n > len)
+			return EXIT_FAILURE;
+
+		while (n--)
+			row[pos++] ^= in[i++];
+	}
+
+	return pos == CHIP8_PROTO_ROW_SIZE ? EXIT_SUCCESS : EXIT_FAILURE;
+}
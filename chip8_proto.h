@@ -0,0 +1,49 @@
+#ifndef _CHIP8_PROTO_H_
+#define _CHIP8_PROTO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+/*
+ * Session protocol. All integers are big endian.
+ *
+ * Each message is : type (1 byte), payload length (2 bytes), payload.
+ *
+ * Client -> server :
+ *   HELLO   session (4)                 attach to a session (CHIP8_PROTO_NEW_SESSION = create one)
+ *   KEY     key (1), pressed (1)        key event
+ *
+ * Server -> client :
+ *   SESSION session (4)                 attached session
+ *   FRAME   frame (4), hires (1), nr_rows (1), then for each row :
+ *           y (1), length (1), encoded row (length bytes)
+ *
+ * A row is CHIP8_PROTO_ROW_SIZE bytes (planes one after the other, pixels most significant bit first).
+ * It is sent XORed with the previous row sent to the same client, then zero run length encoded :
+ *   control byte c & 0x80 : (c & 0x7F) + 1 zero bytes
+ *   control byte c        : c + 1 literal bytes follow
+ */
+#define CHIP8_PROTO_HELLO		0x01
+#define CHIP8_PROTO_KEY			0x02
+#define CHIP8_PROTO_SESSION		0x81
+#define CHIP8_PROTO_FRAME		0x82
+
+#define CHIP8_PROTO_HEADER_SIZE		3
+#define CHIP8_PROTO_NEW_SESSION		0xFFFFFFFF
+#define CHIP8_PROTO_PLANE_ROW_SIZE	(CHIP8_GFX_ROW_WORDS * 8)
+#define CHIP8_PROTO_ROW_SIZE		(CHIP8_GFX_NR_PLANES * CHIP8_PROTO_PLANE_ROW_SIZE)
+#define CHIP8_PROTO_MAX_ROW_SIZE	(CHIP8_PROTO_ROW_SIZE + CHIP8_PROTO_ROW_SIZE / 2 + 1)
+#define CHIP8_PROTO_MAX_FRAME_SIZE	(CHIP8_PROTO_HEADER_SIZE + 6 + CHIP8_GFX_HIRES_HEIGHT * (2 + CHIP8_PROTO_MAX_ROW_SIZE))
+
+void chip8_proto_put16(uint8_t *buf, uint16_t val);
+void chip8_proto_put32(uint8_t *buf, uint32_t val);
+uint16_t chip8_proto_get16(const uint8_t *buf);
+uint32_t chip8_proto_get32(const uint8_t *buf);
+
+void chip8_proto_row(struct chip8_t *chip8, int y, uint8_t *row);
+size_t chip8_proto_encode_row(const uint8_t *prev, const uint8_t *row, uint8_t *out);
+int chip8_proto_decode_row(const uint8_t *in, size_t len, uint8_t *row);
+
+#endif
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "chip8_capture.h"
+
+#define DEFAULT_NR_FRAMES	600
+
+/*
+ * Headless recorder : run a ROM at full speed and capture each 60 Hz frame.
+ */
+int main(int argc, char **argv)
+{
+	enum chip8_capture_format_t format = CHIP8_CAPTURE_Y4M;
+	long nr_frames = DEFAULT_NR_FRAMES, frame;
+	const char *index_path = NULL;
+	struct timespec start, end;
+	struct chip8_capture_t *cap;
+	struct chip8_t *chip8;
+	int quirks = CHIP8_PROFILE_DEFAULT, timing = CHIP8_TIMING_FIXED, ret = EXIT_SUCCESS, opt;
+	double elapsed;
+
+	/* parse options */
+	while ((opt = getopt(argc, argv, "f:i:n:p:t:")) != -1) {
+		switch (opt) {
+			case 'f':
+				if (strcmp(optarg, "rgb") == 0)
+					format = CHIP8_CAPTURE_RGB;
+				else if (strcmp(optarg, "y4m") == 0)
+					format = CHIP8_CAPTURE_Y4M;
+				else
+					goto usage;
+				break;
+			case 'i':
+				index_path = optarg;
+				break;
+			case 'n':
+				nr_frames = atol(optarg);
+				break;
+			case 'p':
+				quirks = chip8_profile(optarg);
+				if (quirks < 0)
+					goto usage;
+				break;
+			case 't':
+				timing = chip8_timing(optarg);
+				if (timing < 0)
+					goto usage;
+				break;
+			default:
+				goto usage;
+		}
+	}
+
+	/* check arguments */
+	if (optind != argc - 2)
+		goto usage;
+
+	/* create chip8 for quirks profile and load rom */
+	chip8 = chip8_create(NULL, quirks);
+	if (!chip8 || chip8_load_rom(chip8, argv[optind])) {
+		fprintf(stderr, "Can't load ROM \"%s\"\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	/* set timing mode */
+	chip8_set_timing(chip8, timing);
+
+	/* open capture */
+	cap = chip8_capture_open(argv[optind + 1], format, index_path);
+	if (!cap) {
+		fprintf(stderr, "Can't open capture output \"%s\"\n", argv[optind + 1]);
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (frame = 0; frame < nr_frames; frame++) {
+		/* emulate one frame */
+		if (chip8_run_frame(chip8)) {
+			fprintf(stderr, "Emulation error at frame %ld\n", frame);
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+
+		/* capture frame */
+		if (chip8_capture_frame(cap, chip8)) {
+			fprintf(stderr, "Can't write frame %ld\n", frame);
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+
+		/* mark gfx clean */
+		chip8->draw_flag = 0;
+	}
+out:
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	fprintf(stderr, "%llu frames (%llu repeated, %llu written) in %.3f s, %llu cycles (%.0f cycles/s emulated)\n",
+		(unsigned long long) cap->nr_frames, (unsigned long long) cap->nr_repeats,
+		(unsigned long long) cap->nr_written, elapsed,
+		(unsigned long long) chip8->cycles, chip8_cycles_per_second(chip8));
+	if (chip8_capture_close(cap)) {
+		fprintf(stderr, "Can't write capture output \"%s\"\n", argv[optind + 1]);
+		ret = EXIT_FAILURE;
+	}
+	chip8_destroy(chip8);
+
+	return ret;
+usage:
+	fprintf(stderr, "Usage: %s [-f y4m|rgb] [-i timestamps] [-n frames] [-p cosmac|schip|xochip] [-t fixed|vip] <rom> <output | ->\n", argv[0]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,701 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "chip8.h"
+#include "chip8_proto.h"
+#include "chip8_export.h"
+#include "chip8_debug.h"
+
+#define DEFAULT_PORT		8000
+#define DEFAULT_MAX_SESSIONS	4096
+#define MAX_EVENTS		256
+#define MAX_LATE_FRAMES		4
+#define CLIENT_IN_SIZE		256
+#define CLIENT_MAX_PENDING	(64 * 1024)
+
+struct client_t;
+
+/*
+ * Emulation session.
+ */
+struct session_t {
+	uint32_t		id;						/* session id */
+	struct chip8_t *	chip8;						/* chip8 device */
+	uint32_t		frame;						/* frame counter */
+	uint32_t		frame_us;					/* emulated time left in current frame */
+	int			error;						/* 1 if chip8 stopped on an error */
+	struct client_t *	clients;					/* attached clients */
+	struct chip8_export_t *	export;						/* shared memory export (NULL if disabled) */
+};
+
+/*
+ * Client connection.
+ */
+struct client_t {
+	int			fd;						/* socket */
+	struct session_t *	session;					/* attached session */
+	struct client_t *	next;						/* next client of session */
+	uint8_t			rows[CHIP8_GFX_HIRES_HEIGHT][CHIP8_PROTO_ROW_SIZE];	/* rows sent to client */
+	int			hires;						/* display mode sent to client (-1 = none) */
+	uint8_t			in[CLIENT_IN_SIZE];				/* input buffer */
+	size_t			in_len;						/* input buffer length */
+	uint8_t *		out;						/* output buffer */
+	size_t			out_len;					/* output buffer length */
+	size_t			out_size;					/* output buffer size */
+	int			want_write;					/* 1 if EPOLLOUT is registered */
+};
+
+/*
+ * Server.
+ */
+struct server_t {
+	int			epfd;						/* epoll */
+	int			listen_fd;					/* listening socket */
+	int			timer_fd;					/* 60 Hz frame timer */
+	struct session_t **	sessions;					/* sessions (indexed by id) */
+	struct chip8_arena_t	arena;						/* sessions memory regions */
+	uint32_t		nr_sessions;					/* number of sessions */
+	uint32_t		max_sessions;					/* maximum number of sessions */
+	uint8_t			quirks;						/* sessions quirks profile */
+	uint8_t			rom[CHIP8_MEMORY_MAX_SIZE - CHIP8_MEMORY_ROM_START];	/* rom */
+	size_t			rom_size;					/* rom size */
+	const char *		export_prefix;					/* export sessions as <prefix>-<id> (NULL = no export) */
+	struct chip8_debug_t *	debug;						/* debugger (NULL if disabled) */
+	uint32_t		debug_session;					/* debugged session */
+};
+
+static volatile sig_atomic_t server_stop = 0;
+
+/*
+ * Termination signal handler.
+ */
+static void server_stop_cb(int sig)
+{
+	(void) sig;
+	server_stop = 1;
+}
+
+/*
+ * Load ROM file.
+ */
+static int server_load_rom(struct server_t *server, const char *path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "rb");
+	if (!fp)
+		return EXIT_FAILURE;
+
+	server->rom_size = fread(server->rom, 1, sizeof(server->rom), fp);
+	fclose(fp);
+
+	/* must fit in the memory of the sessions profile */
+	if (!server->rom_size || server->rom_size > CHIP8_MEMORY_SIZE(server->quirks) - CHIP8_MEMORY_ROM_START)
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Create a session.
+ */
+static struct session_t *session_create(struct server_t *server)
+{
+	char name[CHIP8_EXPORT_NAME_SIZE];
+	struct session_t *session;
+
+	if (server->nr_sessions >= server->max_sessions)
+		return NULL;
+
+	session = (struct session_t *) calloc(1, sizeof(struct session_t));
+	if (!session)
+		return NULL;
+
+	session->chip8 = chip8_create(&server->arena, server->quirks);
+	if (!session->chip8 || chip8_load_rom_buffer(session->chip8, server->rom, server->rom_size)) {
+		chip8_destroy(session->chip8);
+		free(session);
+		return NULL;
+	}
+
+	session->id = server->nr_sessions;
+
+	/* export session to shared memory */
+	if (server->export_prefix) {
+		snprintf(name, sizeof(name), "%s-%u", server->export_prefix, session->id);
+		session->export = (struct chip8_export_t *) malloc(sizeof(struct chip8_export_t));
+		if (!session->export || chip8_export_open(session->export, name)) {
+			free(session->export);
+			chip8_destroy(session->chip8);
+			free(session);
+			return NULL;
+		}
+
+		chip8_export_frame(session->export, session->chip8);
+	}
+
+	server->sessions[server->nr_sessions++] = session;
+
+	return session;
+}
+
+/*
+ * Update epoll interest of a client.
+ */
+static void client_watch(struct server_t *server, struct client_t *client, int want_write)
+{
+	struct epoll_event ev;
+
+	if (client->want_write == want_write)
+		return;
+
+	ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+	ev.data.ptr = client;
+	epoll_ctl(server->epfd, EPOLL_CTL_MOD, client->fd, &ev);
+	client->want_write = want_write;
+}
+
+/*
+ * Flush client output buffer. Returns -1 if connection is broken.
+ */
+static int client_flush(struct server_t *server, struct client_t *client)
+{
+	ssize_t n;
+
+	while (client->out_len > 0) {
+		n = send(client->fd, client->out, client->out_len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		memmove(client->out, client->out + n, client->out_len - n);
+		client->out_len -= n;
+	}
+
+	client_watch(server, client, client->out_len > 0);
+	return 0;
+}
+
+/*
+ * Reserve space in client output buffer.
+ */
+static uint8_t *client_reserve(struct client_t *client, size_t len)
+{
+	uint8_t *out;
+
+	if (client->out_len + len > client->out_size) {
+		out = (uint8_t *) realloc(client->out, client->out_len + len);
+		if (!out)
+			return NULL;
+
+		client->out = out;
+		client->out_size = client->out_len + len;
+	}
+
+	return client->out + client->out_len;
+}
+
+/*
+ * Queue changed rows of a session display to a client.
+ */
+static void client_send_frame(struct client_t *client, uint8_t rows[][CHIP8_PROTO_ROW_SIZE])
+{
+	struct session_t *session = client->session;
+	int y, height = CHIP8_GFX_HEIGHT(session->chip8);
+	size_t len, row_len;
+	uint8_t *msg;
+
+	/* slow client : skip frame, changes will be sent later */
+	if (client->out_len > CLIENT_MAX_PENDING)
+		return;
+
+	msg = client_reserve(client, CHIP8_PROTO_MAX_FRAME_SIZE);
+	if (!msg)
+		return;
+
+	/* frame header */
+	msg[0] = CHIP8_PROTO_FRAME;
+	chip8_proto_put32(msg + 3, session->frame);
+	msg[7] = session->chip8->hires;
+	msg[8] = 0;
+	len = 9;
+
+	/* changed rows */
+	for (y = 0; y < height; y++) {
+		if (client->hires == session->chip8->hires && memcmp(client->rows[y], rows[y], CHIP8_PROTO_ROW_SIZE) == 0)
+			continue;
+
+		row_len = chip8_proto_encode_row(client->rows[y], rows[y], msg + len + 2);
+		msg[len] = y;
+		msg[len + 1] = row_len;
+		len += 2 + row_len;
+		msg[8]++;
+
+		memcpy(client->rows[y], rows[y], CHIP8_PROTO_ROW_SIZE);
+	}
+
+	/* nothing changed */
+	if (!msg[8] && client->hires == session->chip8->hires)
+		return;
+
+	client->hires = session->chip8->hires;
+	chip8_proto_put16(msg + 1, len - CHIP8_PROTO_HEADER_SIZE);
+	client->out_len += len;
+}
+
+/*
+ * Detach a client from its session.
+ */
+static void client_detach(struct client_t *client)
+{
+	struct client_t **pp;
+
+	if (!client->session)
+		return;
+
+	for (pp = &client->session->clients; *pp != NULL; pp = &(*pp)->next) {
+		if (*pp == client) {
+			*pp = client->next;
+			break;
+		}
+	}
+
+	client->session = NULL;
+}
+
+/*
+ * Send session display to all its clients.
+ */
+static void session_broadcast(struct server_t *server, struct session_t *session)
+{
+	uint8_t rows[CHIP8_GFX_HIRES_HEIGHT][CHIP8_PROTO_ROW_SIZE];
+	struct client_t *client, *next;
+	int y;
+
+	for (y = 0; y < CHIP8_GFX_HEIGHT(session->chip8); y++)
+		chip8_proto_row(session->chip8, y, rows[y]);
+
+	for (client = session->clients; client != NULL; client = next) {
+		next = client->next;
+		client_send_frame(client, rows);
+
+		/*
+		 * Broken connection : drop the client from the session and shut the socket down,
+		 * the event loop closes it (pending events of this epoll batch may still reference it).
+		 */
+		if (client_flush(server, client)) {
+			client_detach(client);
+			shutdown(client->fd, SHUT_RDWR);
+		}
+	}
+}
+
+/*
+ * Close a client.
+ */
+static void client_close(struct server_t *server, struct client_t *client)
+{
+	client_detach(client);
+	epoll_ctl(server->epfd, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	free(client->out);
+	free(client);
+}
+
+/*
+ * Attach a client to a session.
+ */
+static int client_attach(struct server_t *server, struct client_t *client, uint32_t id)
+{
+	struct session_t *session;
+	uint8_t *msg;
+
+	/* find or create session */
+	if (id == CHIP8_PROTO_NEW_SESSION)
+		session = session_create(server);
+	else
+		session = id < server->nr_sessions ? server->sessions[id] : NULL;
+
+	if (!session)
+		return -1;
+
+	/* attach */
+	client_detach(client);
+	client->session = session;
+	client->next = session->clients;
+	session->clients = client;
+
+	/* client display is unknown : next frame sends all rows */
+	memset(client->rows, 0, sizeof(client->rows));
+	client->hires = -1;
+
+	/* send session id */
+	msg = client_reserve(client, CHIP8_PROTO_HEADER_SIZE + 4);
+	if (!msg)
+		return -1;
+
+	msg[0] = CHIP8_PROTO_SESSION;
+	chip8_proto_put16(msg + 1, 4);
+	chip8_proto_put32(msg + 3, session->id);
+	client->out_len += CHIP8_PROTO_HEADER_SIZE + 4;
+
+	/* send full display */
+	session_broadcast(server, session);
+
+	return 0;
+}
+
+/*
+ * Handle client messages. Returns -1 to close connection.
+ */
+static int client_read(struct server_t *server, struct client_t *client)
+{
+	size_t len, pos;
+	uint8_t *msg;
+	ssize_t n;
+
+	for (;;) {
+		n = recv(client->fd, client->in + client->in_len, CLIENT_IN_SIZE - client->in_len, 0);
+		if (n == 0)
+			return -1;
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		client->in_len += n;
+
+		/* parse complete messages */
+		for (pos = 0; client->in_len - pos >= CHIP8_PROTO_HEADER_SIZE; pos += CHIP8_PROTO_HEADER_SIZE + len) {
+			msg = client->in + pos;
+			len = chip8_proto_get16(msg + 1);
+			if (len > CLIENT_IN_SIZE - CHIP8_PROTO_HEADER_SIZE)
+				return -1;
+			if (client->in_len - pos < CHIP8_PROTO_HEADER_SIZE + len)
+				break;
+
+			switch (msg[0]) {
+				case CHIP8_PROTO_HELLO:
+					if (len != 4 || client_attach(server, client, chip8_proto_get32(msg + 3)))
+						return -1;
+					break;
+				case CHIP8_PROTO_KEY:
+					if (len != 2)
+						return -1;
+					if (client->session)
+						chip8_key_set(client->session->chip8, msg[3], msg[4]);
+					break;
+				default:
+					return -1;
+			}
+		}
+
+		memmove(client->in, client->in + pos, client->in_len - pos);
+		client->in_len -= pos;
+	}
+}
+
+/*
+ * Accept new clients.
+ */
+static void server_accept(struct server_t *server)
+{
+	struct client_t *client;
+	struct epoll_event ev;
+	int fd, one = 1;
+
+	while ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		client = (struct client_t *) calloc(1, sizeof(struct client_t));
+		if (!client) {
+			close(fd);
+			continue;
+		}
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		client->fd = fd;
+		client->hires = -1;
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = client;
+		if (epoll_ctl(server->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+			close(fd);
+			free(client);
+		}
+	}
+}
+
+/*
+ * Emulate one frame of every session.
+ */
+static void server_frame(struct server_t *server)
+{
+	struct chip8_debug_t *debug;
+	struct session_t *session;
+	uint32_t i;
+
+	/* handle debugger requests */
+	if (server->debug && server->debug_session < server->nr_sessions)
+		chip8_debug_poll(server->debug, server->sessions[server->debug_session]->chip8);
+
+	for (i = 0; i < server->nr_sessions; i++) {
+		session = server->sessions[i];
+		if (session->error)
+			continue;
+
+		/* instrumented ticks only for the session a debugger is attached to */
+		debug = server->debug && i == server->debug_session && CHIP8_DEBUG_ATTACHED(server->debug) ? server->debug : NULL;
+
+		/* emulate one frame */
+		for (session->frame_us += CHIP8_FRAME_FREQ_US; session->frame_us >= CHIP8_TICK_FREQ_US; session->frame_us -= CHIP8_TICK_FREQ_US) {
+			if (debug ? chip8_debug_tick(debug, session->chip8) : chip8_tick(session->chip8)) {
+				session->error = 1;
+				break;
+			}
+		}
+
+		session->frame++;
+
+		/* publish frame to external readers */
+		if (session->export)
+			chip8_export_frame(session->export, session->chip8);
+
+		/* push changed rows */
+		if (session->chip8->draw_flag) {
+			if (session->clients)
+				session_broadcast(server, session);
+
+			session->chip8->draw_flag = 0;
+		}
+	}
+}
+
+/*
+ * Create listening socket, frame timer and epoll.
+ */
+static int server_init(struct server_t *server, const char *addr, int port)
+{
+	struct itimerspec its = { { 0, CHIP8_FRAME_FREQ_US * 1000 }, { 0, CHIP8_FRAME_FREQ_US * 1000 } };
+	struct sockaddr_in sin;
+	struct epoll_event ev;
+	size_t arena_size;
+	void *arena_buf;
+	int one = 1;
+
+	server->sessions = (struct session_t **) calloc(server->max_sessions, sizeof(struct session_t *));
+	if (!server->sessions)
+		return EXIT_FAILURE;
+
+	/* sessions memory regions (sized for the profile) are carved out of one arena (pages are only touched by created sessions) */
+	arena_size = (size_t) server->max_sessions * CHIP8_MEMORY_SIZE(server->quirks) + CHIP8_CACHE_LINE;
+	arena_buf = malloc(arena_size);
+	if (!arena_buf)
+		return EXIT_FAILURE;
+	chip8_arena_init(&server->arena, arena_buf, arena_size);
+
+	/* listening socket */
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	if (inet_pton(AF_INET, addr, &sin.sin_addr) != 1)
+		return EXIT_FAILURE;
+
+	server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (server->listen_fd < 0)
+		return EXIT_FAILURE;
+
+	setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(server->listen_fd, (struct sockaddr *) &sin, sizeof(sin)) || listen(server->listen_fd, SOMAXCONN))
+		return EXIT_FAILURE;
+
+	/* frame timer */
+	server->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (server->timer_fd < 0 || timerfd_settime(server->timer_fd, 0, &its, NULL))
+		return EXIT_FAILURE;
+
+	/* epoll */
+	server->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (server->epfd < 0)
+		return EXIT_FAILURE;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = &server->listen_fd;
+	if (epoll_ctl(server->epfd, EPOLL_CTL_ADD, server->listen_fd, &ev))
+		return EXIT_FAILURE;
+
+	ev.data.ptr = &server->timer_fd;
+	if (epoll_ctl(server->epfd, EPOLL_CTL_ADD, server->timer_fd, &ev))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Event loop.
+ */
+static void server_run(struct server_t *server)
+{
+	struct epoll_event events[MAX_EVENTS];
+	struct client_t *client;
+	uint64_t expirations;
+	int i, n;
+
+	while (!server_stop) {
+		n = epoll_wait(server->epfd, events, MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			/* new connections */
+			if (events[i].data.ptr == &server->listen_fd) {
+				server_accept(server);
+				continue;
+			}
+
+			/* frame timer (catch up a few late frames at most) */
+			if (events[i].data.ptr == &server->timer_fd) {
+				if (read(server->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+					continue;
+
+				if (expirations > MAX_LATE_FRAMES)
+					expirations = MAX_LATE_FRAMES;
+
+				while (expirations--)
+					server_frame(server);
+
+				continue;
+			}
+
+			/* client events */
+			client = (struct client_t *) events[i].data.ptr;
+			if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+				client_close(server, client);
+				continue;
+			}
+
+			if ((events[i].events & EPOLLIN) && client_read(server, client)) {
+				client_close(server, client);
+				continue;
+			}
+
+			if (client_flush(server, client))
+				client_close(server, client);
+		}
+	}
+}
+
+/*
+ * Main.
+ */
+int main(int argc, char **argv)
+{
+	const char *addr = "127.0.0.1";
+	struct server_t server;
+	unsigned int debug_port, debug_session = 0;
+	int opt, port = DEFAULT_PORT, quirks;
+	const char *debug_spec = NULL;
+	uint32_t i;
+
+	memset(&server, 0, sizeof(struct server_t));
+	server.max_sessions = DEFAULT_MAX_SESSIONS;
+	server.quirks = CHIP8_PROFILE_DEFAULT;
+
+	/* parse options */
+	while ((opt = getopt(argc, argv, "l:p:m:e:d:q:")) != -1) {
+		switch (opt) {
+			case 'l':
+				addr = optarg;
+				break;
+			case 'p':
+				port = atoi(optarg);
+				break;
+			case 'm':
+				server.max_sessions = atoi(optarg);
+				break;
+			case 'e':
+				server.export_prefix = optarg;
+				break;
+			case 'd':
+				debug_spec = optarg;
+				break;
+			case 'q':
+				quirks = chip8_profile(optarg);
+				if (quirks < 0)
+					goto usage;
+				server.quirks = quirks;
+				break;
+			default:
+				goto usage;
+		}
+	}
+
+	/* check arguments */
+	if (optind != argc - 1)
+		goto usage;
+
+	/* load rom */
+	if (server_load_rom(&server, argv[optind])) {
+		fprintf(stderr, "Can't load ROM \"%s\"\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	/* start server */
+	if (server_init(&server, addr, port)) {
+		perror("Can't start server");
+		return EXIT_FAILURE;
+	}
+
+	/* listen for a debugger ("port[:session]") */
+	if (debug_spec) {
+		if (sscanf(debug_spec, "%u:%u", &debug_port, &debug_session) < 1)
+			goto usage;
+
+		server.debug = (struct chip8_debug_t *) malloc(sizeof(struct chip8_debug_t));
+		if (!server.debug || chip8_debug_listen(server.debug, debug_port)) {
+			perror("Can't start debugger");
+			return EXIT_FAILURE;
+		}
+
+		server.debug_session = debug_session;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, server_stop_cb);
+	signal(SIGTERM, server_stop_cb);
+	server_run(&server);
+
+	/* remove shared memory exports */
+	for (i = 0; i < server.nr_sessions; i++)
+		if (server.sessions[i]->export)
+			chip8_export_close(server.sessions[i]->export);
+
+	if (server.debug)
+		chip8_debug_close(server.debug);
+
+	return EXIT_SUCCESS;
+usage:
+	fprintf(stderr, "Usage: %s [-l addr] [-p port] [-m max_sessions] [-e /shm_prefix] [-d debug_port[:session]] [-q <cosmac|schip|xochip>] <rom>\n", argv[0]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,78 @@
+#ifndef _CHIP8_SHM_H_
+#define _CHIP8_SHM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Shared memory export of a chip8 session.
+ *
+ * The segment holds two frame slots, each protected by a sequence counter (odd while written).
+ * The writer always fills the slot readers are not pointed to, then publishes it in current.
+ * Readers access a slot in place and check afterwards that its sequence did not change :
+ * no syscall and no copy on the reader side.
+ *
+ * This header does not depend on the emulator so that readers can use it alone.
+ */
+#define CHIP8_SHM_MAGIC			0x43385348	/* "C8SH" */
+#define CHIP8_SHM_VERSION		1
+#define CHIP8_SHM_NR_REGISTERS		16
+#define CHIP8_SHM_STACK_SIZE		16
+#define CHIP8_SHM_NR_PLANES		2
+#define CHIP8_SHM_HEIGHT		64
+#define CHIP8_SHM_ROW_WORDS		2
+
+/* get a pixel of a plane (rows are packed, most significant bit first) */
+#define CHIP8_SHM_PIXEL(frame, plane, x, y) \
+					(((frame)->gfx[plane][y][(x) / 64] >> (63 - (x) % 64)) & 1)
+
+/*
+ * Exported frame.
+ */
+struct chip8_shm_frame_t {
+	uint64_t	frame;							/* frame sequence counter */
+	uint16_t	pc;							/* program counter */
+	uint16_t	I;							/* index register */
+	uint16_t	sp;							/* stack pointer */
+	uint16_t	stack[CHIP8_SHM_STACK_SIZE];				/* stack */
+	uint8_t		V[CHIP8_SHM_NR_REGISTERS];				/* registers */
+	uint8_t		delay_timer;						/* delay timer */
+	uint8_t		sound_timer;						/* sound timer */
+	uint8_t		hires;							/* 1 if display is in 128x64 mode */
+	uint8_t		planes;							/* selected planes bitmask */
+	uint64_t	gfx[CHIP8_SHM_NR_PLANES][CHIP8_SHM_HEIGHT][CHIP8_SHM_ROW_WORDS];	/* graphics planes */
+};
+
+/*
+ * Frame slot.
+ */
+struct chip8_shm_slot_t {
+	_Alignas(64) atomic_uint	seq;					/* sequence (odd while written) */
+	struct chip8_shm_frame_t	frame;					/* frame */
+};
+
+/*
+ * Shared memory segment.
+ */
+struct chip8_shm_t {
+	uint32_t			magic;					/* CHIP8_SHM_MAGIC */
+	uint32_t			version;				/* CHIP8_SHM_VERSION */
+	uint32_t			size;					/* segment size */
+	_Alignas(64) atomic_uint	current;				/* last published slot */
+	struct chip8_shm_slot_t		slots[2];				/* frame slots */
+};
+
+/*
+ * Reader.
+ */
+struct chip8_shm_reader_t {
+	struct chip8_shm_t *		shm;					/* mapped segment */
+};
+
+int chip8_shm_reader_open(struct chip8_shm_reader_t *reader, const char *name);
+const struct chip8_shm_frame_t *chip8_shm_read_begin(struct chip8_shm_reader_t *reader, uint64_t *token);
+int chip8_shm_read_retry(struct chip8_shm_reader_t *reader, uint64_t token);
+void chip8_shm_reader_close(struct chip8_shm_reader_t *reader);
+
+#endif
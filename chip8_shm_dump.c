@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "chip8_shm.h"
+
+#define DEFAULT_INTERVAL_MS	500
+
+/*
+ * Print a snapshot (registers and optionally display).
+ */
+static void dump_frame(const struct chip8_shm_frame_t *frame, int display, unsigned int nr_retries)
+{
+	int width = frame->hires ? 128 : 64, height = frame->hires ? 64 : 32, x, y, i;
+
+	printf("frame %llu pc %03x I %03x sp %u dt %02x st %02x retries %u\n",
+	       (unsigned long long) frame->frame, frame->pc, frame->I, frame->sp,
+	       frame->delay_timer, frame->sound_timer, nr_retries);
+
+	for (i = 0; i < CHIP8_SHM_NR_REGISTERS; i++)
+		printf("V%X=%02x%c", i, frame->V[i], i == CHIP8_SHM_NR_REGISTERS - 1 ? '\n' : ' ');
+
+	if (!display)
+		return;
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++)
+			putchar(CHIP8_SHM_PIXEL(frame, 0, x, y) || CHIP8_SHM_PIXEL(frame, 1, x, y) ? '#' : '.');
+		putchar('\n');
+	}
+}
+
+/*
+ * Example shared memory consumer : print registers (and display) of an exported session.
+ */
+int main(int argc, char **argv)
+{
+	int opt, display = 0, count = -1, interval_ms = DEFAULT_INTERVAL_MS;
+	struct chip8_shm_frame_t copy;
+	const struct chip8_shm_frame_t *frame;
+	struct chip8_shm_reader_t reader;
+	unsigned int nr_retries;
+	struct timespec ts;
+	uint64_t token;
+
+	/* parse options */
+	while ((opt = getopt(argc, argv, "n:i:d")) != -1) {
+		switch (opt) {
+			case 'n':
+				count = atoi(optarg);
+				break;
+			case 'i':
+				interval_ms = atoi(optarg);
+				break;
+			case 'd':
+				display = 1;
+				break;
+			default:
+				goto usage;
+		}
+	}
+
+	/* check arguments */
+	if (optind != argc - 1)
+		goto usage;
+
+	if (chip8_shm_reader_open(&reader, argv[optind])) {
+		fprintf(stderr, "Can't open shared memory \"%s\"\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	ts.tv_sec = interval_ms / 1000;
+	ts.tv_nsec = (interval_ms % 1000) * 1000000L;
+
+	while (count < 0 || count--) {
+		/* take a consistent snapshot (printing is slow : copy it first) */
+		nr_retries = 0;
+		for (;;) {
+			frame = chip8_shm_read_begin(&reader, &token);
+			memcpy(&copy, frame, sizeof(copy));
+			if (!chip8_shm_read_retry(&reader, token))
+				break;
+
+			nr_retries++;
+		}
+
+		dump_frame(&copy, display, nr_retries);
+		fflush(stdout);
+
+		if (count)
+			nanosleep(&ts, NULL);
+	}
+
+	chip8_shm_reader_close(&reader);
+	return EXIT_SUCCESS;
+usage:
+	fprintf(stderr, "Usage: %s [-n count] [-i interval_ms] [-d] </shm_name>\n", argv[0]);
+	return EXIT_FAILURE;
+}
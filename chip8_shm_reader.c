@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "chip8_shm.h"
+
+/*
+ * Open an exported session (read only).
+ */
+int chip8_shm_reader_open(struct chip8_shm_reader_t *reader, const char *name)
+{
+	struct stat st;
+	void *addr;
+	int fd;
+
+	reader->shm = NULL;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return EXIT_FAILURE;
+
+	if (fstat(fd, &st) || (size_t) st.st_size < sizeof(struct chip8_shm_t)) {
+		close(fd);
+		return EXIT_FAILURE;
+	}
+
+	addr = mmap(NULL, sizeof(struct chip8_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return EXIT_FAILURE;
+
+	reader->shm = (struct chip8_shm_t *) addr;
+
+	/* check layout */
+	if (reader->shm->magic != CHIP8_SHM_MAGIC || reader->shm->version != CHIP8_SHM_VERSION
+	    || reader->shm->size != sizeof(struct chip8_shm_t)) {
+		chip8_shm_reader_close(reader);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Start reading last published frame. The returned frame must not be trusted
+ * until chip8_shm_read_retry() returns 0.
+ */
+const struct chip8_shm_frame_t *chip8_shm_read_begin(struct chip8_shm_reader_t *reader, uint64_t *token)
+{
+	struct chip8_shm_slot_t *slot;
+	unsigned int current, seq;
+
+	for (;;) {
+		current = atomic_load_explicit(&reader->shm->current, memory_order_acquire) & 1;
+		slot = &reader->shm->slots[current];
+
+		/* slot being written : writer moved on, read the other one */
+		seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		if (seq & 1)
+			continue;
+
+		*token = ((uint64_t) seq << 1) | current;
+		return &slot->frame;
+	}
+}
+
+/*
+ * Check if the frame returned by chip8_shm_read_begin() changed while it was read.
+ */
+int chip8_shm_read_retry(struct chip8_shm_reader_t *reader, uint64_t token)
+{
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&reader->shm->slots[token & 1].seq, memory_order_relaxed) != (token >> 1);
+}
+
+/*
+ * Close a reader.
+ */
+void chip8_shm_reader_close(struct chip8_shm_reader_t *reader)
+{
+	if (reader->shm)
+		munmap(reader->shm, sizeof(struct chip8_shm_t));
+
+	reader->shm = NULL;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+
+#include "chip8_term.h"
+
+#define TERM_ENTER		"\033[?1049h\033[?25l"		/* alternate screen, hide cursor */
+#define TERM_LEAVE		"\033[0m\033[?25h\033[?1049l"	/* reset colors, show cursor, main screen */
+#define TERM_CLEAR		"\033[0m\033[2J"
+#define TERM_UPPER_HALF		"\342\226\200"			/* U+2580 upper half block */
+
+/*
+ * Write a buffer.
+ */
+static int chip8_term_write(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return EXIT_FAILURE;
+
+		buf += n;
+		len -= n;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Append to frame output.
+ */
+static void chip8_term_append(struct chip8_term_t *term, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	term->len += vsnprintf(term->buf + term->len, sizeof(term->buf) - term->len, fmt, args);
+	va_end(args);
+}
+
+/*
+ * Get 256 colors palette index of a gray level (black, white or gray ramp 232..255 = 8..238).
+ */
+static uint8_t chip8_term_gray(uint8_t level)
+{
+	if (level < 4)
+		return 16;
+	if (level > 246)
+		return 231;
+
+	level = level < 8 ? 0 : (level - 3) / 10;
+	return 232 + (level > 23 ? 23 : level);
+}
+
+/*
+ * Move cursor (relative move when on the same row).
+ */
+static void chip8_term_move(struct chip8_term_t *term, int row, int col)
+{
+	if (term->row == row && term->col == col)
+		return;
+
+	if (term->row == row && col > term->col)
+		chip8_term_append(term, "\033[%dC", col - term->col);
+	else
+		chip8_term_append(term, "\033[%d;%dH", row + 1, col + 1);
+
+	term->row = row;
+	term->col = col;
+}
+
+/*
+ * Set colors (-1 = keep).
+ */
+static void chip8_term_colors(struct chip8_term_t *term, int fg, int bg)
+{
+	if (fg == term->fg)
+		fg = -1;
+	if (bg == term->bg)
+		bg = -1;
+
+	if (fg >= 0 && bg >= 0)
+		chip8_term_append(term, "\033[38;5;%d;48;5;%dm", fg, bg);
+	else if (fg >= 0)
+		chip8_term_append(term, "\033[38;5;%dm", fg);
+	else if (bg >= 0)
+		chip8_term_append(term, "\033[48;5;%dm", bg);
+
+	if (fg >= 0)
+		term->fg = fg;
+	if (bg >= 0)
+		term->bg = bg;
+}
+
+/*
+ * Open terminal renderer (switches to alternate screen).
+ */
+int chip8_term_open(struct chip8_term_t *term, int fd)
+{
+	int i;
+
+	memset(term->cells, CHIP8_TERM_INVALID, sizeof(term->cells));
+	for (i = 0; i < (1 << CHIP8_GFX_NR_PLANES); i++)
+		term->colors[i] = chip8_term_gray(chip8_palette[i]);
+	term->hires = CHIP8_TERM_INVALID;
+	term->row = -1;
+	term->col = -1;
+	term->fg = -1;
+	term->bg = -1;
+	term->fd = fd;
+	term->len = 0;
+	term->nr_frames = 0;
+	term->nr_bytes = 0;
+
+	return chip8_term_write(fd, TERM_ENTER, strlen(TERM_ENTER));
+}
+
+/*
+ * Write a frame : only changed cells are emitted.
+ */
+int chip8_term_frame(struct chip8_term_t *term, const struct chip8_t *chip8)
+{
+	int r, c, p, width, height;
+	uint8_t top, bottom, cell;
+
+	term->len = 0;
+
+	/* resolution changed : clear screen */
+	if (chip8->hires != term->hires) {
+		chip8_term_append(term, TERM_CLEAR);
+		memset(term->cells, CHIP8_TERM_INVALID, sizeof(term->cells));
+		term->hires = chip8->hires;
+		term->row = -1;
+		term->fg = -1;
+		term->bg = -1;
+	}
+
+	width = CHIP8_GFX_WIDTH(chip8);
+	height = CHIP8_GFX_HEIGHT(chip8) / 2;
+
+	for (r = 0; r < height; r++) {
+		for (c = 0; c < width; c++) {
+			/* get cell colors */
+			for (p = 0, top = 0, bottom = 0; p < CHIP8_GFX_NR_PLANES; p++) {
+				top |= CHIP8_GFX_PIXEL(chip8, p, c, 2 * r) << p;
+				bottom |= CHIP8_GFX_PIXEL(chip8, p, c, 2 * r + 1) << p;
+			}
+
+			/* unchanged cell */
+			cell = (top << 2) | bottom;
+			if (cell == term->cells[r][c])
+				continue;
+			term->cells[r][c] = cell;
+
+			/* emit cell (a plain space when both halves match : background only) */
+			chip8_term_move(term, r, c);
+			if (top == bottom) {
+				chip8_term_colors(term, -1, term->colors[top]);
+				chip8_term_append(term, " ");
+			} else {
+				chip8_term_colors(term, term->colors[top], term->colors[bottom]);
+				chip8_term_append(term, TERM_UPPER_HALF);
+			}
+			term->col++;
+		}
+	}
+
+	term->nr_frames++;
+	if (!term->len)
+		return EXIT_SUCCESS;
+
+	term->nr_bytes += term->len;
+	return chip8_term_write(term->fd, term->buf, term->len);
+}
+
+/*
+ * Close terminal renderer (restores main screen).
+ */
+void chip8_term_close(struct chip8_term_t *term)
+{
+	chip8_term_write(term->fd, TERM_LEAVE, strlen(TERM_LEAVE));
+}
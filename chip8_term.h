@@ -0,0 +1,42 @@
+#ifndef _CHIP8_TERM_H_
+#define _CHIP8_TERM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+#define CHIP8_TERM_MAX_COLS		CHIP8_GFX_HIRES_WIDTH
+#define CHIP8_TERM_MAX_ROWS		(CHIP8_GFX_HIRES_HEIGHT / 2)
+#define CHIP8_TERM_CELL_MAX_LEN		32		/* cursor move + colors + glyph */
+#define CHIP8_TERM_BUF_SIZE		(CHIP8_TERM_MAX_COLS * CHIP8_TERM_MAX_ROWS * CHIP8_TERM_CELL_MAX_LEN + 64)
+#define CHIP8_TERM_INVALID		0xFF		/* cell never drawn */
+
+/*
+ * ANSI terminal renderer : each cell is an upper half block (top pixel = foreground,
+ * bottom pixel = background), so the display takes width x height/2 cells.
+ *
+ * The last emitted cells, cursor position and colors are kept, so a frame only emits
+ * the cursor moves, SGR sequences and glyphs of the cells that changed. A frame is
+ * written with a single write().
+ */
+struct chip8_term_t {
+	uint8_t			cells[CHIP8_TERM_MAX_ROWS][CHIP8_TERM_MAX_COLS];	/* emitted cells (top color << 2 | bottom color) */
+	uint8_t			colors[1 << CHIP8_GFX_NR_PLANES];	/* 256 colors palette index of plane combinations */
+	uint8_t			hires;					/* resolution of emitted cells (CHIP8_TERM_INVALID = none) */
+	int			row;					/* cursor row (-1 = unknown) */
+	int			col;					/* cursor column */
+	int			fg;					/* current foreground color (-1 = unknown) */
+	int			bg;					/* current background color (-1 = unknown) */
+	int			fd;					/* output file descriptor */
+	char			buf[CHIP8_TERM_BUF_SIZE];		/* frame output */
+	size_t			len;					/* frame output length */
+	uint64_t		nr_frames;				/* number of frames written */
+	uint64_t		nr_bytes;				/* number of bytes written */
+};
+
+int chip8_term_open(struct chip8_term_t *term, int fd);
+int chip8_term_frame(struct chip8_term_t *term, const struct chip8_t *chip8);
+void chip8_term_close(struct chip8_term_t *term);
+
+#endif
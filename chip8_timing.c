@@ -0,0 +1,111 @@
+#include "chip8.h"
+
+/*
+ * COSMAC VIP instruction costs, in machine cycles, modeled on the original interpreter :
+ * every instruction pays the fetch/decode loop, then its own routine. Values are
+ * approximations of the interpreter's instruction paths (taken branches, loops per
+ * byte, per row or per digit), not a cycle exact trace. Opcodes the VIP interpreter
+ * doesn't know (SUPER-CHIP, XO-CHIP) get a flat cost.
+ */
+#define VIP_FETCH		40		/* fetch, decode and dispatch */
+#define VIP_SKIP		4		/* extra cost of a taken skip */
+#define VIP_CLEAR		3078		/* 00E0 : clear 256 display bytes */
+#define VIP_DRAW_SETUP		26		/* DXYN : locate display byte, set up sprite */
+#define VIP_DRAW_ROW		46		/* DXYN : xor one sprite row on a byte boundary */
+#define VIP_DRAW_UNALIGNED	22		/* DXYN : xor into a second display byte */
+#define VIP_DRAW_SHIFT		8		/* DXYN : shift one sprite row by one bit */
+#define VIP_BCD			80		/* FX33 : setup */
+#define VIP_BCD_DIGIT		16		/* FX33 : per unit counted in a digit */
+#define VIP_LOAD_STORE		14		/* FX55, FX65 : setup and per register */
+#define VIP_OTHER		20		/* non VIP instructions */
+
+/*
+ * Get cost of a DXYN draw : each row is shifted to the x alignment and xored into
+ * one display byte (aligned) or two.
+ */
+static uint32_t chip8_vip_draw_cycles(const struct chip8_t *chip8, uint16_t opcode)
+{
+	uint8_t shift = chip8->V[(opcode & 0x0F00) >> 8] & 7;
+	uint32_t rows = opcode & 0x000F, row;
+
+	/* 16x16 sprite : two bytes per row */
+	if (rows == 0)
+		rows = 32;
+
+	row = VIP_DRAW_ROW;
+	if (shift)
+		row += VIP_DRAW_UNALIGNED + VIP_DRAW_SHIFT * shift;
+
+	return VIP_DRAW_SETUP + rows * row;
+}
+
+/*
+ * Get cost of next instruction (called before it is executed).
+ */
+uint32_t chip8_vip_cycles(const struct chip8_t *chip8, uint16_t opcode)
+{
+	uint8_t x = (opcode & 0x0F00) >> 8, y = (opcode & 0x00F0) >> 4, val;
+
+	switch (opcode & 0xF000) {
+		case 0x0000:
+			if (opcode == 0x00E0)
+				return VIP_FETCH + VIP_CLEAR;
+			if (opcode == 0x00EE)
+				return VIP_FETCH + 10;
+			return VIP_FETCH + VIP_OTHER;
+		case 0x1000:
+			return VIP_FETCH + 12;
+		case 0x2000:
+			return VIP_FETCH + 26;
+		case 0x3000:
+			return VIP_FETCH + 10 + (chip8->V[x] == (opcode & 0x00FF) ? VIP_SKIP : 0);
+		case 0x4000:
+			return VIP_FETCH + 10 + (chip8->V[x] != (opcode & 0x00FF) ? VIP_SKIP : 0);
+		case 0x5000:
+			return VIP_FETCH + 14 + (chip8->V[x] == chip8->V[y] ? VIP_SKIP : 0);
+		case 0x6000:
+			return VIP_FETCH + 6;
+		case 0x7000:
+			return VIP_FETCH + 10;
+		case 0x8000:
+			return VIP_FETCH + 44;
+		case 0x9000:
+			return VIP_FETCH + 14 + (chip8->V[x] != chip8->V[y] ? VIP_SKIP : 0);
+		case 0xA000:
+			return VIP_FETCH + 12;
+		case 0xB000:
+			return VIP_FETCH + 22;
+		case 0xC000:
+			return VIP_FETCH + 36;
+		case 0xD000:
+			return VIP_FETCH + chip8_vip_draw_cycles(chip8, opcode);
+		case 0xE000:
+			val = chip8->key[chip8->V[x] & 0x0F];
+			if ((opcode & 0x00FF) == 0x00A1)
+				val = !val;
+			return VIP_FETCH + 14 + (val ? VIP_SKIP : 0);
+		default:
+			break;
+	}
+
+	/* FX instructions */
+	switch (opcode & 0x00FF) {
+		case 0x0007:
+		case 0x0015:
+		case 0x0018:
+			return VIP_FETCH + 10;
+		case 0x000A:
+			return VIP_FETCH + 16;
+		case 0x001E:
+		case 0x0029:
+			return VIP_FETCH + 16;
+		case 0x0033:
+			val = chip8->V[x];
+			return VIP_FETCH + VIP_BCD + VIP_BCD_DIGIT * (val / 100 + val / 10 % 10 + val % 10);
+		case 0x0055:
+		case 0x0065:
+			return VIP_FETCH + VIP_LOAD_STORE * (x + 2);
+		default:
+			return VIP_FETCH + VIP_OTHER;
+	}
+}
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+
+#include "chip8.h"
+#include "chip8_input.h"
+#include "chip8_term.h"
+
+#define DEFAULT_HOLD_FRAMES	6			/* a terminal sends no key release : hold presses ~100 ms */
+#define MAX_LATE_FRAMES		10			/* resynchronize pacing when later than this */
+#define KEY_QUIT		0x03			/* Ctrl-C (raw mode : no SIGINT) */
+
+static volatile sig_atomic_t tty_stop = 0;
+
+/*
+ * Stop handler.
+ */
+static void stop_cb(int sig)
+{
+	(void) sig;
+	tty_stop = 1;
+}
+
+/*
+ * Get monotonic time in us.
+ */
+static int64_t tty_time_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Read pending keys : presses are queued (releases are queued by the main loop).
+ */
+static int tty_read_keys(struct chip8_input_t *input, int64_t *press_us, uint16_t *keys)
+{
+	char buf[64];
+	int64_t now;
+	ssize_t n, i;
+	uint8_t key;
+
+	n = read(STDIN_FILENO, buf, sizeof(buf));
+	if (n <= 0)
+		return n < 0 && errno == EAGAIN ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	now = tty_time_us();
+	for (i = 0; i < n; i++) {
+		if (buf[i] == KEY_QUIT) {
+			tty_stop = 1;
+			break;
+		}
+
+		key = CHIP8_INPUT_KEY(input, (uint8_t) buf[i]);
+		if (key == CHIP8_INPUT_NO_KEY)
+			continue;
+
+		/* key repeat only extends the press */
+		if (!(*keys & (1 << key)))
+			chip8_input_push(input, key, 1, now);
+		*keys |= 1 << key;
+		press_us[key] = now;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Terminal front end : renders the display with half blocks, only changed cells are written.
+ */
+int main(int argc, char **argv)
+{
+	int64_t press_us[CHIP8_NR_KEYS], hold_us, emu_us, deadline, now;
+	struct termios saved_tio, tio;
+	static struct chip8_input_t input;
+	static struct chip8_term_t term;
+	struct chip8_t *chip8;
+	int quirks = CHIP8_PROFILE_DEFAULT, timing = CHIP8_TIMING_FIXED, raw = 0, ret = EXIT_FAILURE, opt, i;
+	long nr_frames = 0, frame = 0;
+	struct pollfd pfd;
+	struct timespec ts;
+	struct sigaction sa;
+	uint16_t keys = 0;
+
+	hold_us = DEFAULT_HOLD_FRAMES * CHIP8_FRAME_FREQ_US;
+
+	/* parse options */
+	while ((opt = getopt(argc, argv, "k:n:p:t:")) != -1) {
+		switch (opt) {
+			case 'k':
+				hold_us = atol(optarg) * CHIP8_FRAME_FREQ_US;
+				break;
+			case 'n':
+				nr_frames = atol(optarg);
+				break;
+			case 'p':
+				quirks = chip8_profile(optarg);
+				if (quirks < 0)
+					goto usage;
+				break;
+			case 't':
+				timing = chip8_timing(optarg);
+				if (timing < 0)
+					goto usage;
+				break;
+			default:
+				goto usage;
+		}
+	}
+
+	/* check arguments */
+	if (optind != argc - 1 || hold_us <= 0)
+		goto usage;
+
+	/* create chip8 for quirks profile and load rom */
+	chip8 = chip8_create(NULL, quirks);
+	if (!chip8 || chip8_load_rom(chip8, argv[optind])) {
+		fprintf(stderr, "Can't load ROM \"%s\"\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	/* set timing mode */
+	chip8_set_timing(chip8, timing);
+
+	/* keys are queued (minimum hold covers the whole press) */
+	chip8_input_init(&input);
+	input.hold_us = hold_us;
+
+	/* stop on SIGINT/SIGTERM (no restart : ppoll() must return) */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_cb;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+
+	/* raw non blocking keyboard (stdin may also be a pipe or /dev/null) */
+	if (tcgetattr(STDIN_FILENO, &saved_tio) == 0) {
+		tio = saved_tio;
+		cfmakeraw(&tio);
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+		raw = tcsetattr(STDIN_FILENO, TCSANOW, &tio) == 0;
+	}
+	pfd.fd = STDIN_FILENO;
+	pfd.events = POLLIN;
+
+	if (chip8_term_open(&term, STDOUT_FILENO)) {
+		fprintf(stderr, "Can't write to terminal\n");
+		goto out_tio;
+	}
+
+	emu_us = tty_time_us();
+	deadline = emu_us;
+	for (frame = 0; !tty_stop && (!nr_frames || frame < nr_frames); frame++) {
+		/* wait for frame deadline, timestamping keys as they arrive */
+		deadline += CHIP8_FRAME_FREQ_US;
+		while (!tty_stop && (now = tty_time_us()) < deadline) {
+			ts.tv_sec = (deadline - now) / 1000000;
+			ts.tv_nsec = (deadline - now) % 1000000 * 1000;
+			if (ppoll(&pfd, 1, &ts, NULL) > 0 && tty_read_keys(&input, press_us, &keys))
+				pfd.fd = -1;
+		}
+
+		/* too late (suspended, slow terminal) : don't try to catch up */
+		now = tty_time_us();
+		if (now - deadline > MAX_LATE_FRAMES * CHIP8_FRAME_FREQ_US)
+			emu_us = deadline = now;
+
+		/* release keys held long enough */
+		for (i = 0; i < CHIP8_NR_KEYS; i++) {
+			if ((keys & (1 << i)) && press_us[i] + hold_us <= deadline) {
+				chip8_input_push(&input, i, 0, press_us[i] + hold_us);
+				keys &= ~(1 << i);
+			}
+		}
+
+		/* VIP timing : emulate a whole frame on a cycle budget */
+		if (timing == CHIP8_TIMING_VIP) {
+			chip8_input_apply(&input, chip8, deadline);
+			if (chip8_run_frame(chip8)) {
+				fprintf(stderr, "Emulation error at frame %ld\n", frame);
+				goto out;
+			}
+		}
+
+		/* emulate up to frame deadline, applying key events at their instruction */
+		for (; timing == CHIP8_TIMING_FIXED && emu_us + CHIP8_TICK_FREQ_US <= deadline; emu_us += CHIP8_TICK_FREQ_US) {
+			chip8_input_apply(&input, chip8, emu_us);
+			if (chip8_tick(chip8)) {
+				fprintf(stderr, "Emulation error at frame %ld\n", frame);
+				goto out;
+			}
+		}
+
+		/* write changed cells */
+		if (chip8->draw_flag) {
+			chip8->draw_flag = 0;
+			chip8_input_frame(&input, chip8);
+			if (chip8_term_frame(&term, chip8)) {
+				fprintf(stderr, "Can't write to terminal\n");
+				goto out;
+			}
+		}
+		chip8_input_present(&input, tty_time_us());
+	}
+
+	ret = EXIT_SUCCESS;
+out:
+	/* restore terminal */
+	chip8_term_close(&term);
+out_tio:
+	if (raw)
+		tcsetattr(STDIN_FILENO, TCSANOW, &saved_tio);
+
+	fprintf(stderr, "%ld frames, %llu written, %llu bytes (%.1f bytes/frame), %.0f cycles/s\n", frame,
+		(unsigned long long) term.nr_frames, (unsigned long long) term.nr_bytes,
+		frame ? (double) term.nr_bytes / frame : 0.0, chip8_cycles_per_second(chip8));
+	chip8_input_print_latency(&input, stderr);
+	chip8_destroy(chip8);
+
+	return ret;
+usage:
+	fprintf(stderr, "Usage: %s [-k hold_frames] [-n frames] [-p <cosmac|schip|xochip>] [-t <fixed|vip>] <rom>\n", argv[0]);
+	return EXIT_FAILURE;
+}
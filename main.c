@@ -1,22 +1,37 @@
 #include <unistd.h>
+#include <string.h>
 #include <gtk/gtk.h>
 
 #include "chip8.h"
+#include "chip8_audio.h"
+#include "chip8_netplay.h"
+#include "chip8_export.h"
+#include "chip8_debug.h"
+#include "chip8_input.h"
 
 #define WINDOW_WIDTH		800
 #define WINDOW_HEIGHT		600
 #define UNUSED(x)		((void) (x))
+#define ALSA_PREFIX		"alsa:"
 
 /*
  * Chip8 emulator.
  */
 struct chip8_emulator_t {
-	struct chip8_t		chip8;			/* chip8 device */
+	struct chip8_t *	chip8;			/* chip8 device */
 	GtkWidget *		window;			/* main window */
 	GtkWidget *		frame;			/* main frame */
 	GdkPixbuf *		pixbuf;			/* pix buf */
 	GtkWidget *		drawing_area;		/* drawing area */
 	gint64			prev_tick_time;		/* previous tick time */
+	struct chip8_audio_t *	audio;			/* audio synthesizer (NULL if disabled) */
+	struct chip8_netplay_t *netplay;		/* netplay session (NULL if disabled) */
+	uint16_t		keys;			/* local keys bitmap */
+	gint64			netplay_time;		/* time not yet emulated in netplay mode */
+	gint64			frame_time;		/* time not yet emulated in VIP timing */
+	struct chip8_export_t *	export;			/* shared memory export (NULL if disabled) */
+	struct chip8_debug_t *	debug;			/* debugger (NULL if disabled) */
+	struct chip8_input_t	input;			/* key event queue and latency histogram */
 };
 
 /*
@@ -44,6 +59,9 @@ static gboolean draw_cb(GtkWidget *widget, cairo_t *cr, gpointer data)
 	cairo_paint(cr);
 	g_object_unref(scaled);
 
+	/* frame presented : measure input latency */
+	chip8_input_present(&emu->input, g_get_monotonic_time());
+
 	return TRUE;
 }
 
@@ -53,27 +71,115 @@ static gboolean draw_cb(GtkWidget *widget, cairo_t *cr, gpointer data)
 static void key_cb(GtkWidget *widget, GdkEventKey *event, gpointer data)
 {
 	struct chip8_emulator_t *emu = (struct chip8_emulator_t *) data;
-	int i;
+	int pressed = event->type == GDK_KEY_PRESS;
+	uint8_t key;
 
 	UNUSED(widget);
 
-	if (event->keyval > 0xFF)
-		return;
-	
 	/* find matching chip8 key */
-	for (i = 0; i < CHIP8_NR_KEYS; i++)
-		if (event->keyval == chip8_keymap[i])
-			break;
-
-	/* no matching key */
-	if (i >= CHIP8_NR_KEYS)
+	key = CHIP8_INPUT_KEY(&emu->input, event->keyval);
+	if (key == CHIP8_INPUT_NO_KEY)
 		return;
 
-	/* set chip8 key */
-	if (event->type == GDK_KEY_PRESS)
-		emu->chip8.key[i] = 1;
+	/* in netplay mode, keypad is set by netplay from local and remote keys */
+	if (pressed)
+		emu->keys |= 1 << key;
 	else
-		emu->chip8.key[i] = 0;
+		emu->keys &= ~(1 << key);
+
+	/* else queue event : it's applied at the matching emulated instruction */
+	if (!emu->netplay)
+		chip8_input_push(&emu->input, key, pressed, g_get_monotonic_time());
+}
+
+/*
+ * Update pixbuf from chip8 display.
+ */
+static void update_pixbuf(struct chip8_emulator_t *emu)
+{
+	int x, y, p, scale, rowstride;
+	guchar *pixels, *pixel;
+	uint8_t val;
+
+	/* get gtk pixels */
+	pixels = gdk_pixbuf_get_pixels(emu->pixbuf);
+	rowstride = gdk_pixbuf_get_rowstride(emu->pixbuf);
+
+	/* low resolution pixels are scaled to the high resolution pixbuf */
+	scale = emu->chip8->hires ? 1 : 2;
+
+	/* draw gfx */
+	for (y = 0; y < CHIP8_GFX_HIRES_HEIGHT; y++) {
+		for (x = 0; x < CHIP8_GFX_HIRES_WIDTH; x++) {
+			/* get pixel value */
+			for (p = 0, val = 0; p < CHIP8_GFX_NR_PLANES; p++)
+				val |= CHIP8_GFX_PIXEL(emu->chip8, p, x / scale, y / scale) << p;
+			val = chip8_palette[val];
+
+			/* set gtk pixel */
+			pixel = pixels + y * rowstride + x * 3;
+			pixel[0] = val;
+			pixel[1] = val;
+			pixel[2] = val;
+		}
+	}
+
+	/* queue drawing area */
+	gtk_widget_queue_draw(emu->drawing_area);
+	chip8_input_frame(&emu->input, emu->chip8);
+
+	/* mark gfx clean */
+	emu->chip8->draw_flag = 0;
+}
+
+/*
+ * Emulate netplay frames for elapsed time.
+ */
+static void netplay_tick(struct chip8_emulator_t *emu, gint64 current_time, gint64 elapsed)
+{
+	enum chip8_netplay_status_t status;
+
+	for (emu->netplay_time += elapsed; emu->netplay_time >= CHIP8_FRAME_FREQ_US; emu->netplay_time -= CHIP8_FRAME_FREQ_US) {
+		status = chip8_netplay_frame(emu->netplay, emu->keys, current_time);
+		if (status == CHIP8_NETPLAY_ERROR)
+			exit(EXIT_FAILURE);
+
+		/* waiting for remote : don't try to catch up later */
+		if (status == CHIP8_NETPLAY_WAITING) {
+			emu->netplay_time = 0;
+			break;
+		}
+
+		/* generate audio */
+		if (emu->audio)
+			chip8_audio_tick(emu->audio, emu->chip8, CHIP8_FRAME_FREQ_US);
+
+		/* redraw if needed */
+		if (emu->chip8->draw_flag)
+			update_pixbuf(emu);
+	}
+}
+
+/*
+ * Emulate VIP timing frames for elapsed time.
+ */
+static void vip_tick(struct chip8_emulator_t *emu, gint64 current_time, gint64 elapsed)
+{
+	for (emu->frame_time += elapsed; emu->frame_time >= CHIP8_FRAME_FREQ_US; emu->frame_time -= CHIP8_FRAME_FREQ_US) {
+		/* apply key events received up to the end of this frame */
+		chip8_input_apply(&emu->input, emu->chip8, current_time - emu->frame_time + CHIP8_FRAME_FREQ_US);
+
+		if (chip8_run_frame(emu->chip8))
+			exit(EXIT_FAILURE);
+
+		/* generate audio */
+		if (emu->audio)
+			chip8_audio_tick(emu->audio, emu->chip8, CHIP8_FRAME_FREQ_US);
+
+		/* redraw if needed */
+		if (emu->chip8->draw_flag)
+			update_pixbuf(emu);
+	}
 }
 
 /*
@@ -82,67 +188,70 @@ static void key_cb(GtkWidget *widget, GdkEventKey *event, gpointer data)
 static gboolean tick_cb(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer data)
 {
 	struct chip8_emulator_t *emu = (struct chip8_emulator_t *) data;
-	int ret, x, y, i, nb_chip8_ticks;
-	gint64 current_time;
-	guchar *pixels;
-	uint8_t val;
-	guint ptr;
+	int ret, i, nb_chip8_ticks;
+	gint64 current_time, elapsed;
 
 	/* unused variables */
 	UNUSED(widget);
 
 	/* get number of chip8 ticks to emulate */
 	current_time = gdk_frame_clock_get_frame_time(frame_clock);
-	if (!emu->prev_tick_time)
-		nb_chip8_ticks = 1;
-	else
-		nb_chip8_ticks = (current_time - emu->prev_tick_time) / CHIP8_TICK_FREQ_US;
+	elapsed = emu->prev_tick_time ? current_time - emu->prev_tick_time : CHIP8_TICK_FREQ_US;
+	nb_chip8_ticks = elapsed / CHIP8_TICK_FREQ_US;
 
 	/* update previous tick time */
 	emu->prev_tick_time = current_time;
 
-	/* emulate chip8 */
+	/* netplay : emulate whole frames */
+	if (emu->netplay) {
+		netplay_tick(emu, current_time, elapsed);
+		goto out;
+	}
+
+	/* VIP timing : emulate whole frames on a cycle budget */
+	if (emu->chip8->timing == CHIP8_TIMING_VIP) {
+		vip_tick(emu, current_time, elapsed);
+		goto out;
+	}
+
+	/* handle debugger requests */
+	if (emu->debug)
+		chip8_debug_poll(emu->debug, emu->chip8);
+
+	/* emulate chip8 (last tick matches current time) */
 	for (i = 0; i < nb_chip8_ticks; i++) {
-		/* next tick */
-		ret = chip8_tick(&emu->chip8);
+		/* apply key events received up to this instruction */
+		chip8_input_apply(&emu->input, emu->chip8, current_time - (gint64) (nb_chip8_ticks - 1 - i) * CHIP8_TICK_FREQ_US);
+
+		/* next tick (instrumented only while a debugger is attached) */
+		if (emu->debug && CHIP8_DEBUG_ATTACHED(emu->debug))
+			ret = chip8_debug_tick(emu->debug, emu->chip8);
+		else
+			ret = chip8_tick(emu->chip8);
 		if (ret)
 			exit(EXIT_FAILURE);
 
+		/* generate audio */
+		if (emu->audio)
+			chip8_audio_tick(emu->audio, emu->chip8, CHIP8_TICK_FREQ_US);
+
 		/* redraw if needed */
-		if (emu->chip8.draw_flag) {
-			/* get gtk pixels */
-			pixels = gdk_pixbuf_get_pixels(emu->pixbuf);
-
-			/* draw gfx */
-			for (y = 0; y < CHIP8_GFX_HEIGHT; y++) {
-				for (x = 0; x < CHIP8_GFX_WIDTH; x++) {
-					/* get pixel value */
-					ptr = y * CHIP8_GFX_WIDTH + x;
-					val = emu->chip8.gfx[ptr] ? 0xFF : 0x00;
-
-					/* set gtk pixel */
-					ptr *= 3;
-					pixels[ptr] = val;
-					pixels[ptr + 1] = val;
-					pixels[ptr + 1] = val;
-				}
-			}
-
-			/* queue drawing area */
-			gtk_widget_queue_draw(emu->drawing_area);
-			
-			/* mark gfx clean */
-			emu->chip8.draw_flag = 0;
-		}
+		if (emu->chip8->draw_flag)
+			update_pixbuf(emu);
 	}
 
+out:
+	/* publish frame to external readers */
+	if (emu->export)
+		chip8_export_frame(emu->export, emu->chip8);
+
 	return G_SOURCE_CONTINUE;
 }
 
 /*
- * Create chip8 emulator.
+ * Create chip8 emulator (chip8 memory is sized for the quirks profile).
  */
-struct chip8_emulator_t *chip8_emulator_create()
+struct chip8_emulator_t *chip8_emulator_create(uint8_t quirks)
 {
 	struct chip8_emulator_t *emu;
 
@@ -151,8 +260,23 @@ struct chip8_emulator_t *chip8_emulator_create()
 	if (!emu)
 		return NULL;
 
+	/* create chip8 device */
+	emu->chip8 = chip8_create(NULL, quirks);
+	if (!emu->chip8) {
+		free(emu);
+		return NULL;
+	}
+
 	/* init emulator */
 	emu->prev_tick_time = 0;
+	emu->audio = NULL;
+	emu->netplay = NULL;
+	emu->keys = 0;
+	emu->netplay_time = 0;
+	emu->frame_time = 0;
+	emu->export = NULL;
+	emu->debug = NULL;
+	chip8_input_init(&emu->input);
 
 	/* create main window */
 	emu->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
@@ -165,7 +289,7 @@ struct chip8_emulator_t *chip8_emulator_create()
 	gtk_frame_set_shadow_type(GTK_FRAME(emu->frame), GTK_SHADOW_IN);
 
 	/* create drawing area */
-	emu->pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, CHIP8_GFX_WIDTH, CHIP8_GFX_HEIGHT);
+	emu->pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, CHIP8_GFX_HIRES_WIDTH, CHIP8_GFX_HIRES_HEIGHT);
 	emu->drawing_area = gtk_drawing_area_new();
 
 	/* pack widgets */
@@ -187,35 +311,159 @@ struct chip8_emulator_t *chip8_emulator_create()
  */
 int main(int argc, char **argv)
 {
+	struct chip8_audio_sink_t *audio_sink = NULL;
+	struct chip8_audio_backend_t audio_backend;
 	struct chip8_emulator_t *emu;
-	int ret;
+	const char *audio_path = NULL, *netplay_spec = NULL, *export_name = NULL;
+	unsigned int local_port, remote_port, debug_port = 0;
+	int quirks = CHIP8_PROFILE_DEFAULT, timing = CHIP8_TIMING_FIXED;
+	char remote_host[64];
+	int ret, opt;
 	
 	/* init gtk */
 	gtk_init(&argc, &argv);
 
-	/* check arguments */
-	if (argc != 2) {
-		printf("Usage: %s <rom>\n", argv[0]);
-		return EXIT_FAILURE;
+	/* parse options */
+	while ((opt = getopt(argc, argv, "a:n:e:d:p:t:")) != -1) {
+		switch (opt) {
+			case 'a':
+				audio_path = optarg;
+				break;
+			case 'n':
+				netplay_spec = optarg;
+				break;
+			case 'e':
+				export_name = optarg;
+				break;
+			case 'd':
+				debug_port = atoi(optarg);
+				break;
+			case 'p':
+				quirks = chip8_profile(optarg);
+				if (quirks < 0)
+					goto usage;
+				break;
+			case 't':
+				timing = chip8_timing(optarg);
+				if (timing < 0)
+					goto usage;
+				break;
+			default:
+				goto usage;
+		}
 	}
 
+	/* check arguments */
+	if (optind != argc - 1)
+		goto usage;
+
 	/* create chip8 emulator */
-	emu = chip8_emulator_create();
+	emu = chip8_emulator_create(quirks);
 	if (!emu) {
 		fprintf(stderr, "Can't create chip8 emulator\n");
 		return EXIT_FAILURE;
 	}
 
 	/* load rom */
-	ret = chip8_load_rom(&emu->chip8, argv[1]);
+	ret = chip8_load_rom(emu->chip8, argv[optind]);
 	if (ret) {
-		fprintf(stderr, "Can't load ROM \"%s\"\n", argv[1]);
+		fprintf(stderr, "Can't load ROM \"%s\"\n", argv[optind]);
 		return EXIT_FAILURE;
 	}
 
+	/* set timing mode */
+	chip8_set_timing(emu->chip8, timing);
+
+	/* start netplay ("local_port:remote_host:remote_port") : fixed timing only */
+	if (netplay_spec) {
+		if (timing != CHIP8_TIMING_FIXED)
+			goto usage;
+
+		if (sscanf(netplay_spec, "%u:%63[^:]:%u", &local_port, remote_host, &remote_port) != 3)
+			goto usage;
+
+		/* snapshots embed cache line aligned contexts */
+		emu->netplay = (struct chip8_netplay_t *) aligned_alloc(_Alignof(struct chip8_netplay_t), sizeof(struct chip8_netplay_t));
+		if (!emu->netplay || chip8_netplay_init(emu->netplay, emu->chip8, local_port, remote_host, remote_port)) {
+			fprintf(stderr, "Can't start netplay \"%s\"\n", netplay_spec);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* listen for a debugger (not in netplay mode : rollbacks would replay breakpoints, nor in VIP timing : whole frames) */
+	if (debug_port) {
+		if (emu->netplay || timing != CHIP8_TIMING_FIXED)
+			goto usage;
+
+		emu->debug = (struct chip8_debug_t *) malloc(sizeof(struct chip8_debug_t));
+		if (!emu->debug || chip8_debug_listen(emu->debug, debug_port)) {
+			fprintf(stderr, "Can't listen for debugger on port %u\n", debug_port);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* export display and registers to shared memory */
+	if (export_name) {
+		emu->export = (struct chip8_export_t *) malloc(sizeof(struct chip8_export_t));
+		if (!emu->export || chip8_export_open(emu->export, export_name)) {
+			fprintf(stderr, "Can't export to shared memory \"%s\"\n", export_name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* start audio output : sound device by default, "-" = null sink, "alsa:<device>" = ALSA device, else WAV file */
+	if (!audio_path)
+		audio_sink = chip8_audio_sink_alsa(CHIP8_AUDIO_DEFAULT_DEVICE, CHIP8_AUDIO_RATE);
+	else if (strcmp(audio_path, "-") == 0)
+		audio_sink = chip8_audio_sink_null(CHIP8_AUDIO_RATE);
+	else if (strncmp(audio_path, ALSA_PREFIX, strlen(ALSA_PREFIX)) == 0)
+		audio_sink = chip8_audio_sink_alsa(audio_path + strlen(ALSA_PREFIX), CHIP8_AUDIO_RATE);
+	else
+		audio_sink = chip8_audio_sink_wav(audio_path, CHIP8_AUDIO_RATE);
+
+	/* no sound device : run silent unless an output was asked for */
+	if (!audio_sink && !audio_path)
+		fprintf(stderr, "Can't open sound device \"%s\" : audio disabled\n", CHIP8_AUDIO_DEFAULT_DEVICE);
+
+	if (audio_sink || audio_path) {
+		/* ring indexes are cache line aligned : malloc() only guarantees 16 bytes */
+		emu->audio = (struct chip8_audio_t *) aligned_alloc(_Alignof(struct chip8_audio_t), sizeof(struct chip8_audio_t));
+		if (!audio_sink || !emu->audio) {
+			fprintf(stderr, "Can't open audio output \"%s\"\n", audio_path ? audio_path : CHIP8_AUDIO_DEFAULT_DEVICE);
+			return EXIT_FAILURE;
+		}
+
+		chip8_audio_init(emu->audio, CHIP8_AUDIO_RATE);
+		if (chip8_audio_backend_start(&audio_backend, emu->audio, audio_sink)) {
+			fprintf(stderr, "Can't start audio backend\n");
+			return EXIT_FAILURE;
+		}
+	}
+
 	/* show main window */
 	gtk_widget_show_all(emu->window);
 	gtk_main();
 
+	/* stop audio output */
+	if (audio_sink) {
+		chip8_audio_backend_stop(&audio_backend);
+		audio_sink->close(audio_sink);
+	}
+
+	/* report input latency and emulated speed */
+	chip8_input_print_latency(&emu->input, stdout);
+	printf("%llu cycles (%.0f cycles/s)\n", (unsigned long long) emu->chip8->cycles, chip8_cycles_per_second(emu->chip8));
+
+	/* stop debugger */
+	if (emu->debug)
+		chip8_debug_close(emu->debug);
+
+	/* remove shared memory export */
+	if (emu->export)
+		chip8_export_close(emu->export);
+
 	return EXIT_SUCCESS;
+usage:
+	printf("Usage: %s [-a <wav file | - | alsa:device>] [-n <local_port:remote_host:remote_port>] [-e </shm_name>] [-d <debug_port>] [-p <cosmac|schip|xochip>] [-t <fixed|vip>] <rom>\n", argv[0]);
+	return EXIT_FAILURE;
 }
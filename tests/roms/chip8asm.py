@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+#
+# Minimal CHIP-8 / SUPER-CHIP / XO-CHIP assembler for the test ROMs.
+#
+# Usage: chip8asm.py <source.asm> <output.ch8>
+#
+# One instruction per line, Cowgod mnemonics ("label:" defines a label, ";" starts a comment) :
+#
+#   cls  ret  scr  scl  low  high  scd N  scu N  plane N
+#   jp ADDR  jp v0, ADDR  call ADDR
+#   se vX, NN|vY  sne vX, NN|vY  ld vX, NN|vY  add vX, NN|vY
+#   or/and/xor/sub/shr/subn/shl vX, vY
+#   ld i, ADDR  ld [i], vX  ld vX, [i]  ld dt, vX  ld vX, dt  ld st, vX  ld hf, vX
+#   drw vX, vY, N
+#   db BYTE, ...
+#
+# Numbers are decimal or 0x hexadecimal, ADDR is a number or a label.
+#
+
+import sys
+
+ORIGIN = 0x200
+
+SIMPLE = {'cls': 0x00E0, 'ret': 0x00EE, 'scr': 0x00FB, 'scl': 0x00FC, 'low': 0x00FE, 'high': 0x00FF}
+NIBBLE = {'scd': 0x00C0, 'scu': 0x00D0, 'plane': 0xF001}
+ALU = {'or': 1, 'and': 2, 'xor': 3, 'sub': 5, 'shr': 6, 'subn': 7, 'shl': 0xE}
+FX = {'dt': 0x15, 'st': 0x18, 'hf': 0x30}
+
+
+class AsmError(Exception):
+    pass
+
+
+def reg(arg):
+    if len(arg) != 2 or arg[0] != 'v':
+        raise AsmError('register expected : "%s"' % arg)
+    return int(arg[1], 16)
+
+
+def is_reg(arg):
+    return len(arg) == 2 and arg[0] == 'v' and arg[1] in '0123456789abcdef'
+
+
+def num(arg, bits):
+    val = int(arg, 0)
+    if val < 0 or val >= 1 << bits:
+        raise AsmError('value out of range : "%s"' % arg)
+    return val
+
+
+def encode(op, args, labels):
+    def addr(arg):
+        if arg in labels:
+            return labels[arg]
+        return num(arg, 12)
+
+    if op in SIMPLE and not args:
+        return [SIMPLE[op]]
+    if op in NIBBLE and len(args) == 1:
+        n = num(args[0], 4)
+        return [NIBBLE[op] | (n << 8 if op == 'plane' else n)]
+    if op == 'jp' and len(args) == 1:
+        return [0x1000 | addr(args[0])]
+    if op == 'jp' and len(args) == 2 and args[0] == 'v0':
+        return [0xB000 | addr(args[1])]
+    if op == 'call' and len(args) == 1:
+        return [0x2000 | addr(args[0])]
+    if op in ('se', 'sne') and len(args) == 2:
+        x = reg(args[0])
+        if is_reg(args[1]):
+            return [(0x5000 if op == 'se' else 0x9000) | x << 8 | reg(args[1]) << 4]
+        return [(0x3000 if op == 'se' else 0x4000) | x << 8 | num(args[1], 8)]
+    if op == 'add' and len(args) == 2 and args[0] == 'i':
+        return [0xF01E | reg(args[1]) << 8]
+    if op == 'add' and len(args) == 2:
+        x = reg(args[0])
+        if is_reg(args[1]):
+            return [0x8004 | x << 8 | reg(args[1]) << 4]
+        return [0x7000 | x << 8 | num(args[1], 8)]
+    if op in ALU and len(args) == 2:
+        return [0x8000 | reg(args[0]) << 8 | reg(args[1]) << 4 | ALU[op]]
+    if op == 'drw' and len(args) == 3:
+        return [0xD000 | reg(args[0]) << 8 | reg(args[1]) << 4 | num(args[2], 4)]
+    if op == 'ld' and len(args) == 2:
+        dst, src = args
+        if dst == 'i':
+            return [0xA000 | addr(src)]
+        if dst == '[i]':
+            return [0xF055 | reg(src) << 8]
+        if src == '[i]':
+            return [0xF065 | reg(dst) << 8]
+        if dst in FX:
+            return [0xF000 | reg(src) << 8 | FX[dst]]
+        if src == 'dt':
+            return [0xF007 | reg(dst) << 8]
+        if is_reg(src):
+            return [0x8000 | reg(dst) << 8 | reg(src) << 4]
+        return [0x6000 | reg(dst) << 8 | num(src, 8)]
+
+    raise AsmError('unknown instruction : "%s %s"' % (op, ', '.join(args)))
+
+
+def parse(path):
+    lines = []
+    with open(path) as fp:
+        for nr, line in enumerate(fp, 1):
+            line = line.split(';')[0].strip().lower()
+            while ':' in line:
+                label, line = line.split(':', 1)
+                lines.append((nr, 'label', [label.strip()]))
+                line = line.strip()
+            if line:
+                op, _, rest = line.partition(' ')
+                lines.append((nr, op, [a.strip() for a in rest.split(',')] if rest.strip() else []))
+    return lines
+
+
+def assemble(path):
+    lines = parse(path)
+    labels, pc = {}, ORIGIN
+
+    # first pass : label addresses
+    for nr, op, args in lines:
+        if op == 'label':
+            labels[args[0]] = pc
+        else:
+            pc += len(args) if op == 'db' else 2
+
+    # second pass : encode
+    out = bytearray()
+    for nr, op, args in lines:
+        try:
+            if op == 'label':
+                continue
+            if op == 'db':
+                out += bytes(num(a, 8) for a in args)
+                continue
+            for word in encode(op, args, labels):
+                out += bytes([word >> 8, word & 0xFF])
+        except (AsmError, ValueError) as err:
+            raise SystemExit('%s:%d: %s' % (path, nr, err))
+
+    return bytes(out)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        raise SystemExit('Usage: %s <source.asm> <output.ch8>' % sys.argv[0])
+
+    with open(sys.argv[2], 'wb') as fp:
+        fp.write(assemble(sys.argv[1]))
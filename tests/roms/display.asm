@@ -0,0 +1,45 @@
+; Display test ROM (assemble with chip8asm.py) : high resolution, big font, 16x16 sprites,
+; scrolling and planes.
+
+	high
+
+	; big font 5 (8x10) at (2, 3)
+	ld v0, 5
+	ld hf, v0
+	ld v1, 2
+	ld v2, 3
+	drw v1, v2, 10
+
+	; 16x16 sprite at (20, 5)
+	ld i, big
+	ld v1, 20
+	ld v2, 5
+	drw v1, v2, 0
+
+	scd 3
+	scr
+
+	; same sprite on plane 2 only, overlapping at (24, 8)
+	plane 2
+	ld i, big
+	ld v1, 24
+	ld v2, 8
+	drw v1, v2, 0
+
+	; both planes at the bottom right corner (wraps unless clipped)
+	plane 3
+	ld v1, 122
+	ld v2, 60
+	drw v1, v2, 0
+
+	scl
+	scu 1
+
+end:
+	jp end
+
+big:
+	db 0xF0, 0x0F, 0x81, 0x81, 0x42, 0x42, 0x24, 0x24
+	db 0x18, 0x18, 0x18, 0x18, 0x24, 0x24, 0x42, 0x42
+	db 0x81, 0x81, 0xFF, 0xFF, 0x00, 0x00, 0xAA, 0x55
+	db 0x55, 0xAA, 0xFF, 0x00, 0x00, 0xFF, 0xF0, 0x0F
@@ -0,0 +1,230 @@
+; Quirks test ROM (assemble with chip8asm.py).
+;
+; Each check leaves its result in V3 and Vf in V4, stored as two bytes in its result slot.
+; Results are then drawn as a sprite : one byte per row (result then Vf), 7 checks per column.
+
+	; check 0 : 8XY4 without carry
+	ld v3, 0x10
+	ld v2, 0x20
+	add v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result0
+	ld [i], v1
+
+	; check 1 : 8XY4 with carry
+	ld v3, 0xF0
+	ld v2, 0x20
+	add v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result1
+	ld [i], v1
+
+	; check 2 : 8FY4 : flag wins over result
+	ld vf, 0xF0
+	ld v2, 0x20
+	add vf, v2
+	ld v4, vf
+	ld v3, vf			; result is in Vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result2
+	ld [i], v1
+
+	; check 3 : 8XY5 with borrow
+	ld v3, 0x10
+	ld v2, 0x20
+	sub v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result3
+	ld [i], v1
+
+	; check 4 : 8XY5 with equal operands
+	ld v3, 0x20
+	ld v2, 0x20
+	sub v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result4
+	ld [i], v1
+
+	; check 5 : 8XY7
+	ld v3, 0x10
+	ld v2, 0x20
+	subn v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result5
+	ld [i], v1
+
+	; check 6 : 8XY6 shifts Vy (Vx with shift quirk)
+	ld v3, 0x05
+	ld v2, 0x81
+	shr v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result6
+	ld [i], v1
+
+	; check 7 : 8XYE shifts Vy (Vx with shift quirk)
+	ld v3, 0x05
+	ld v2, 0x81
+	shl v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result7
+	ld [i], v1
+
+	; check 8 : 8XY1 (Vf reset quirk)
+	ld v3, 0x0F
+	ld v2, 0xF0
+	ld vf, 0x55
+	or v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result8
+	ld [i], v1
+
+	; check 9 : 8XY2 (Vf reset quirk)
+	ld v3, 0x0F
+	ld v2, 0xF0
+	ld vf, 0x55
+	and v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result9
+	ld [i], v1
+
+	; check 10 : 8XY3 (Vf reset quirk)
+	ld v3, 0x0F
+	ld v2, 0xF0
+	ld vf, 0x55
+	xor v3, v2
+	ld v4, vf
+	ld v0, v3
+	ld v1, v4
+	ld i, result10
+	ld [i], v1
+
+	; check 11 : FX55 / FX65 increment I (unless load/store quirk)
+	; V0 is read back from table[0] (I unchanged) or table[2] (I incremented)
+	ld v0, 0x11
+	ld v1, 0x22
+	ld i, table
+	ld [i], v1
+	ld v0, [i]
+	ld v3, v0
+	ld v4, 0x00
+	ld v0, v3
+	ld v1, v4
+	ld i, result11
+	ld [i], v1
+
+	; check 12 : BNNN jumps to NNN + V0 (XNN + VX with jump quirk, X = 2 as jump_table is at 0x2XX)
+	ld v0, 0x00
+	ld v2, 0x04
+	jp v0, jump_table
+jump_table:
+	ld v3, 0x01			; NNN + V0
+	jp jump_done
+	ld v3, 0x02			; XNN + V2
+jump_done:
+	ld v4, 0x00
+	ld v0, v3
+	ld v1, v4
+	ld i, result12
+	ld [i], v1
+
+	; check 13 : delay timer after about 650 instructions (60 Hz countdown from 255)
+	ld v0, 0xFF
+	ld dt, v0
+	ld v1, 0x00
+	ld v2, 0x01
+delay_loop:
+	add v1, v2
+	se v1, 200
+	jp delay_loop
+	ld v3, dt
+	ld v4, 0x00
+	ld v0, v3
+	ld v1, v4
+	ld i, result13
+	ld [i], v1
+
+	; draw results : checks 0 to 6 in the first column, 7 to 13 in the second
+	cls
+	ld v0, 0
+	ld v1, 0
+	ld i, result0
+	drw v0, v1, 14
+	ld v0, 8
+	ld i, result7
+	drw v0, v1, 14
+
+	; sprite across the bottom right corner : clipped (clip quirk) or wrapped
+	ld v0, 60
+	ld v1, 30
+	ld i, sprite
+	drw v0, v1, 4
+
+end:
+	jp end
+
+table:
+	db 0xAA, 0xBB, 0xCC, 0xDD
+
+sprite:
+	db 0xFF, 0x81, 0x81, 0xFF
+
+; result slots (result, Vf), spare slots for new checks
+result0:
+	db 0x00, 0x00
+result1:
+	db 0x00, 0x00
+result2:
+	db 0x00, 0x00
+result3:
+	db 0x00, 0x00
+result4:
+	db 0x00, 0x00
+result5:
+	db 0x00, 0x00
+result6:
+	db 0x00, 0x00
+result7:
+	db 0x00, 0x00
+result8:
+	db 0x00, 0x00
+result9:
+	db 0x00, 0x00
+result10:
+	db 0x00, 0x00
+result11:
+	db 0x00, 0x00
+result12:
+	db 0x00, 0x00
+result13:
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00
+	db 0x00, 0x00